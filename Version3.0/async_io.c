@@ -0,0 +1,250 @@
+/*
+* async_io.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "async_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __linux__
+/**
+  * Set up an io_uring and map its submission and completion rings.
+  *
+  * Parameters:
+  * - io: Pointer to AsyncIo structure.
+  * - entries: integer, size of the submission queue.
+  *
+  * return value:
+  * - int: 0 on success, -1 if io_uring is not available.
+  */
+static int uringSetup(AsyncIo *io, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return -1;
+    }
+    io->ringFd = fd;
+    io->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    io->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cqRingSize > io->sqRingSize) {
+            io->sqRingSize = io->cqRingSize;
+        }
+        io->cqRingSize = io->sqRingSize;
+    }
+    io->sqRing = mmap(NULL, io->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (io->sqRing == MAP_FAILED) {
+        io->sqRing = NULL;
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        io->cqRing = io->sqRing;
+    } else {
+        io->cqRing = mmap(NULL, io->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (io->cqRing == MAP_FAILED) {
+            io->cqRing = NULL;
+            return -1;
+        }
+    }
+    io->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED) {
+        io->sqes = NULL;
+        return -1;
+    }
+
+    unsigned char *sq = (unsigned char*)io->sqRing;
+    unsigned char *cq = (unsigned char*)io->cqRing;
+    io->sqHead = (unsigned*)(sq + params.sq_off.head);
+    io->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    io->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    io->sqArray = (unsigned*)(sq + params.sq_off.array);
+    io->cqHead = (unsigned*)(cq + params.cq_off.head);
+    io->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    io->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    io->cqes = cq + params.cq_off.cqes;
+    // The completion queue is at least as large as the submission queue, so it never overflows
+    io->entries = params.sq_entries < entries ? params.sq_entries : entries;
+    return 0;
+}
+
+/**
+  * Unmap the rings and close the io_uring.
+  */
+static void uringTeardown(AsyncIo *io) {
+    if (io->sqes != NULL) {
+        munmap(io->sqes, io->sqesSize);
+    }
+    if (io->cqRing != NULL && io->cqRing != io->sqRing) {
+        munmap(io->cqRing, io->cqRingSize);
+    }
+    if (io->sqRing != NULL) {
+        munmap(io->sqRing, io->sqRingSize);
+    }
+    if (io->ringFd >= 0) {
+        close(io->ringFd);
+    }
+    io->sqes = io->cqRing = io->sqRing = NULL;
+    io->ringFd = -1;
+}
+#endif
+
+/**
+  * Initialize asynchronous reads, using io_uring when the system has it.
+  *
+  * Parameters:
+  * - io: Pointer to AsyncIo structure to initialize.
+  * - entries: integer, maximum number of reads in flight.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+int asyncIoInit(AsyncIo *io, unsigned entries) {
+    memset(io, 0, sizeof(AsyncIo));
+    io->ringFd = -1;
+    io->entries = entries;
+#ifdef __linux__
+    if (uringSetup(io, entries) == 0) {
+        io->uring = true;
+        return 0;
+    }
+    uringTeardown(io);
+    io->entries = entries;
+#endif
+    io->ready = (AsyncCompletion*)malloc(entries * sizeof(AsyncCompletion));
+    if (io->ready == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for AsyncIo.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Start reading length bytes at offset of fd into buffer. The buffer must stay valid until the read is reaped.
+  *
+  * Parameters:
+  * - io: Pointer to AsyncIo structure.
+  * - fd: file descriptor to read from.
+  * - buffer: destination of the read.
+  * - length: number of bytes to read.
+  * - offset: position in the file.
+  * - userData: value returned with the completion.
+  *
+  * return value:
+  * - int: 0 if the read was started, -1 if the queue is full or the submission failed.
+  */
+int asyncIoRead(AsyncIo *io, int fd, void *buffer, size_t length, int64_t offset, uint64_t userData) {
+    if (io->inFlight >= io->entries) {
+        return -1;
+    }
+#ifdef __linux__
+    if (io->uring) {
+        unsigned tail = *io->sqTail;
+        unsigned index = tail & *io->sqMask;
+        struct io_uring_sqe *sqe = &((struct io_uring_sqe*)io->sqes)[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)buffer;
+        sqe->len = (uint32_t)length;
+        sqe->off = (uint64_t)offset;
+        sqe->user_data = userData;
+        io->sqArray[index] = index;
+        __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+        // Submit right away: the caller may close fd before the next call
+        if (syscall(__NR_io_uring_enter, io->ringFd, 1, 0, 0, NULL, 0) != 1) {
+            __atomic_store_n(io->sqTail, tail, __ATOMIC_RELEASE);
+            return -1;
+        }
+        io->inFlight++;
+        return 0;
+    }
+#endif
+    ssize_t n = pread(fd, buffer, length, (off_t)offset);
+    io->ready[io->readyCount++] = (AsyncCompletion){ .userData = userData, .result = n < 0 ? -errno : (int)n };
+    io->inFlight++;
+    return 0;
+}
+
+/**
+  * Collect finished reads.
+  *
+  * Parameters:
+  * - io: Pointer to AsyncIo structure.
+  * - completions: array that receives the completions.
+  * - max: size of the array.
+  * - minComplete: integer, wait until at least this many reads have finished (limited to the reads in flight).
+  *
+  * return value:
+  * - int: Number of completions stored, or -1 if waiting failed.
+  */
+int asyncIoReap(AsyncIo *io, AsyncCompletion *completions, int max, int minComplete) {
+    if (minComplete > (int)io->inFlight) {
+        minComplete = (int)io->inFlight;
+    }
+    if (minComplete > max) {
+        minComplete = max;
+    }
+    int count = 0;
+#ifdef __linux__
+    if (io->uring) {
+        for (;;) {
+            unsigned head = *io->cqHead;
+            unsigned tail = __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE);
+            while (head != tail && count < max) {
+                struct io_uring_cqe *cqe = &((struct io_uring_cqe*)io->cqes)[head & *io->cqMask];
+                completions[count++] = (AsyncCompletion){ .userData = cqe->user_data, .result = cqe->res };
+                io->inFlight--;
+                head++;
+            }
+            __atomic_store_n(io->cqHead, head, __ATOMIC_RELEASE);
+            if (count >= minComplete) {
+                return count;
+            }
+            if (syscall(__NR_io_uring_enter, io->ringFd, 0, minComplete - count, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+                && errno != EINTR) {
+                fprintf(stderr, "Error: Unable to wait for disk reads.\n");
+                return count > 0 ? count : -1;
+            }
+        }
+    }
+#endif
+    while (count < max && io->readyCount > 0) {
+        completions[count++] = io->ready[--io->readyCount];
+    }
+    io->inFlight -= (unsigned)count;
+    return count;
+}
+
+/**
+  * Release the io_uring or the completion queue. Reads still in flight are waited for.
+  *
+  * Parameters:
+  * - io: Pointer to AsyncIo structure.
+  */
+void asyncIoClose(AsyncIo *io) {
+#ifdef __linux__
+    if (io->uring) {
+        AsyncCompletion completions[16];
+        while (io->inFlight > 0 && asyncIoReap(io, completions, 16, 1) > 0) {
+        }
+        uringTeardown(io);
+    }
+#endif
+    free(io->ready);
+    io->ready = NULL;
+    io->inFlight = 0;
+}
@@ -0,0 +1,53 @@
+/*
+* async_io.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_ASYNC_IO_H
+#define P1_ASYNC_IO_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+//Number of reads that can be in flight at the same time
+#define ASYNC_QUEUE_DEPTH 64
+
+//Result of one read: userData as passed to asyncIoRead, result is the byte count or -errno
+typedef struct AsyncCompletion {
+    uint64_t userData;
+    int result;
+} AsyncCompletion;
+
+/*
+ * Asynchronous positional reads. On Linux they go through an io_uring set up with the raw system calls
+ * (no liburing). Where io_uring is not available (other systems, old kernels, blocked by a sandbox)
+ * a read is done at once with pread and its completion is queued, so callers see the same interface.
+ */
+typedef struct AsyncIo {
+    bool uring;
+    unsigned entries;
+    unsigned inFlight;          //reads submitted and not yet reaped
+    //Completions of synchronous reads
+    AsyncCompletion *ready;
+    unsigned readyCount;
+    //io_uring rings
+    int ringFd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    void *sqes;
+    size_t sqesSize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    void *cqes;
+} AsyncIo;
+
+int asyncIoInit(AsyncIo *io, unsigned entries);
+int asyncIoRead(AsyncIo *io, int fd, void *buffer, size_t length, int64_t offset, uint64_t userData);
+int asyncIoReap(AsyncIo *io, AsyncCompletion *completions, int max, int minComplete);
+void asyncIoClose(AsyncIo *io);
+#endif //P1_ASYNC_IO_H
@@ -0,0 +1,163 @@
+/*
+* bench_index.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "cache_table.h"
+#include "swiss_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+//Define the benchmark: slots (buckets) of both indexes, operations per measurement, load factors compared
+#define BENCH_SLOTS (1 << 18)
+#define BENCH_OPERATIONS (1 << 22)
+static const double BENCH_LOADS[] = { 0.25, 0.5, 0.75, 0.875 };
+
+/**
+  * Small xorshift generator, so the benchmark does not measure rand().
+  */
+static uint32_t benchRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+  * The n-th key of the benchmark. Multiplying by an odd constant is a bijection modulo 2^30,
+  * so the keys are distinct, scattered and even; key + 1 is never in the index.
+  */
+static int benchKey(uint32_t n) {
+    return (int)(((n * 2654435761u) & 0x3fffffff) << 1);
+}
+
+/**
+  * Allocate an entry on the heap, one malloc per entry.
+  */
+static CacheHashEntry* benchEntry(int key) {
+    CacheHashEntry *entry = (CacheHashEntry*)calloc(1, sizeof(CacheHashEntry));
+    if (entry == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for CacheHashEntry.\n");
+        exit(1);
+    }
+    entry->key = key;
+    return entry;
+}
+
+/**
+  * One index under test, either the chained table or the Swiss table.
+  */
+typedef struct BenchIndex {
+    int swiss;
+    CacheHashTable table;
+    SwissTable swissTable;
+} BenchIndex;
+
+static CacheHashEntry* benchFind(BenchIndex *index, int key) {
+    return index->swiss ? swissFind(&index->swissTable, key) : cacheTableFind(&index->table, key);
+}
+
+static void benchInsert(BenchIndex *index, CacheHashEntry *entry) {
+    if (index->swiss) {
+        if (swissInsert(&index->swissTable, entry) != 0) {
+            exit(1);
+        }
+    } else {
+        cacheTableInsert(&index->table, entry);
+    }
+}
+
+static CacheHashEntry* benchRemove(BenchIndex *index, int key) {
+    return index->swiss ? swissRemove(&index->swissTable, key) : cacheTableRemove(&index->table, key);
+}
+
+/**
+  * Fill an index with BENCH_SLOTS * load entries and time hit lookups, miss lookups
+  * and remove/insert churn, in nanoseconds per operation.
+  *
+  * Parameters:
+  * - swiss: integer, 1 for the Swiss table, 0 for the chained table.
+  * - load: double, load factor (entries per slot or per bucket), at most 7/8 so neither index resizes.
+  */
+static void benchIndex(int swiss, double load) {
+    BenchIndex index = { .swiss = swiss };
+    // Both indexes get BENCH_SLOTS slots: the Swiss table is sized for its 7/8 limit
+    int initialized = swiss ? swissInit(&index.swissTable, BENCH_SLOTS / SWISS_MAX_LOAD_DEN * SWISS_MAX_LOAD_NUM)
+                            : cacheTableInit(&index.table, BENCH_SLOTS);
+    if (initialized != 0) {
+        exit(1);
+    }
+    int entries = (int)(BENCH_SLOTS * load);
+    int *keys = (int*)malloc(entries * sizeof(int));
+    if (keys == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the benchmark keys.\n");
+        exit(1);
+    }
+    uint32_t nextKey = 0;
+    for (int i = 0; i < entries; i++) {
+        keys[i] = benchKey(nextKey++);
+        benchInsert(&index, benchEntry(keys[i]));
+    }
+
+    uint32_t state = 2463534242u;
+    long found = 0;
+    double start = nowNs();
+    for (int i = 0; i < BENCH_OPERATIONS; i++) {
+        found += benchFind(&index, keys[benchRandom(&state) % entries]) != NULL;
+    }
+    double hit = (nowNs() - start) / BENCH_OPERATIONS;
+
+    start = nowNs();
+    for (int i = 0; i < BENCH_OPERATIONS; i++) {
+        found += benchFind(&index, keys[benchRandom(&state) % entries] + 1) != NULL;
+    }
+    double miss = (nowNs() - start) / BENCH_OPERATIONS;
+
+    // Evict a random entry and cache a new message, as store_msg does once the cache is full
+    start = nowNs();
+    for (int i = 0; i < BENCH_OPERATIONS; i++) {
+        int slot = benchRandom(&state) % entries;
+        free(benchRemove(&index, keys[slot]));
+        keys[slot] = benchKey(nextKey++);
+        benchInsert(&index, benchEntry(keys[slot]));
+    }
+    double churn = (nowNs() - start) / BENCH_OPERATIONS;
+
+    printf("%-8s %6.3f %10d %12.1f %12.1f %12.1f %8s\n", swiss ? "swiss" : "chained", load, entries,
+           hit, miss, churn, found == BENCH_OPERATIONS ? "ok" : "WRONG");
+    for (int i = 0; i < entries; i++) {
+        free(benchRemove(&index, keys[i]));
+    }
+    if (swiss) {
+        swissDestroy(&index.swissTable);
+    } else {
+        cacheTableDestroy(&index.table);
+    }
+    free(keys);
+}
+
+/**
+  * Compare the chained cache hash table with the Swiss table at several load factors.
+  *
+  * Usage: bench_index
+  */
+int main() {
+    printf("%-8s %6s %10s %12s %12s %12s %8s\n", "index", "load", "entries", "hit ns/op", "miss ns/op", "churn ns/op", "check");
+    for (size_t i = 0; i < sizeof(BENCH_LOADS) / sizeof(BENCH_LOADS[0]); i++) {
+        benchIndex(0, BENCH_LOADS[i]);
+        benchIndex(1, BENCH_LOADS[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+* bloom.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "bloom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/**
+  * Mix a key into a 64-bit hash (splitmix64 finalizer).
+  *
+  * Parameters:
+  * - key: integer key.
+  *
+  * return value:
+  * - uint64_t: 64-bit hash of the key.
+  */
+static uint64_t bloomHash(int key) {
+    uint64_t x = (uint64_t)(uint32_t)key + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+  * Size a Bloom filter for a number of keys and a target false-positive rate.
+  * Uses m = -n*ln(p)/ln(2)^2 bits and k = m/n*ln(2) hash functions.
+  *
+  * Parameters:
+  * - filter: Pointer to BloomFilter structure to initialize.
+  * - capacity: expected number of keys.
+  * - falsePositiveRate: target false-positive rate, between 0 and 1.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the rate is out of range or memory allocation failed.
+  */
+int bloomInit(BloomFilter *filter, uint64_t capacity, double falsePositiveRate) {
+    if (falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0) {
+        fprintf(stderr, "Error: Bloom filter false-positive rate must be between 0 and 1.\n");
+        return -1;
+    }
+    if (capacity < 64) {
+        capacity = 64;
+    }
+    double ln2 = log(2.0);
+    uint64_t bitCount = (uint64_t)ceil(-(double)capacity * log(falsePositiveRate) / (ln2 * ln2));
+    bitCount = (bitCount + 63) & ~63ull;
+    int hashCount = (int)round((double)bitCount / (double)capacity * ln2);
+    if (hashCount < 1) {
+        hashCount = 1;
+    }
+
+    filter->bits = (uint64_t*)calloc(bitCount / 64, sizeof(uint64_t));
+    if (filter->bits == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for BloomFilter.\n");
+        return -1;
+    }
+    filter->bitCount = bitCount;
+    filter->hashCount = hashCount;
+    filter->capacity = capacity;
+    filter->count = 0;
+    filter->falsePositiveRate = falsePositiveRate;
+    return 0;
+}
+
+/**
+  * Add a key to the filter. Bit positions use double hashing: h1 + i*h2.
+  *
+  * Parameters:
+  * - filter: Pointer to BloomFilter structure.
+  * - key: integer key.
+  */
+void bloomAdd(BloomFilter *filter, int key) {
+    uint64_t hash = bloomHash(key);
+    uint64_t h1 = hash & 0xFFFFFFFFull;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < filter->hashCount; i++) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) % filter->bitCount;
+        filter->bits[bit / 64] |= 1ull << (bit % 64);
+    }
+    filter->count++;
+}
+
+/**
+  * Test whether a key may be in the filter.
+  *
+  * Parameters:
+  * - filter: Pointer to BloomFilter structure.
+  * - key: integer key.
+  *
+  * return value:
+  * - bool: false if the key was never added; true if it was added or on a false positive.
+  */
+bool bloomMayContain(const BloomFilter *filter, int key) {
+    uint64_t hash = bloomHash(key);
+    uint64_t h1 = hash & 0xFFFFFFFFull;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < filter->hashCount; i++) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) % filter->bitCount;
+        if ((filter->bits[bit / 64] & (1ull << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * Release the bit array of the filter.
+  *
+  * Parameters:
+  * - filter: Pointer to BloomFilter structure.
+  */
+void bloomFree(BloomFilter *filter) {
+    free(filter->bits);
+    filter->bits = NULL;
+    filter->bitCount = 0;
+    filter->count = 0;
+}
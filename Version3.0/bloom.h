@@ -0,0 +1,27 @@
+/*
+* bloom.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_BLOOM_H
+#define P1_BLOOM_H
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct BloomFilter {
+    uint64_t *bits;
+    uint64_t bitCount;
+    int hashCount;
+    uint64_t capacity;   //number of keys the filter was sized for
+    uint64_t count;      //number of keys added
+    double falsePositiveRate;
+} BloomFilter;
+
+int bloomInit(BloomFilter *filter, uint64_t capacity, double falsePositiveRate);
+void bloomAdd(BloomFilter *filter, int key);
+bool bloomMayContain(const BloomFilter *filter, int key);
+void bloomFree(BloomFilter *filter);
+#endif //P1_BLOOM_H
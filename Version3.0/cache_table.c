@@ -0,0 +1,232 @@
+/*
+* cache_table.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "cache_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+  * Bucket of a key in a table of the given size (a power of two). The key is mixed first,
+  * so identifiers that share their low bits do not share a bucket.
+  */
+static int bucketOf(int key, int size) {
+    uint32_t hash = (uint32_t)key * 2654435761u;
+    hash ^= hash >> 16;
+    return (int)(hash & (uint32_t)(size - 1));
+}
+
+/**
+  * Push an entry on the chain of a bucket.
+  */
+static void linkEntry(CacheHashEntry **bucket, CacheHashEntry *entry) {
+    entry->next = *bucket;
+    if (entry->next != NULL) {
+        entry->next->pprev = &entry->next;
+    }
+    *bucket = entry;
+    entry->pprev = bucket;
+}
+
+/**
+  * Allocate an empty bucket array.
+  *
+  * return value:
+  * - CacheHashEntry**: Pointer to size empty buckets, or NULL if memory allocation failed.
+  */
+static CacheHashEntry** allocBuckets(int size) {
+    CacheHashEntry **buckets = (CacheHashEntry**)calloc(size, sizeof(CacheHashEntry*));
+    if (buckets == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for CacheHashTable.\n");
+    }
+    return buckets;
+}
+
+/**
+  * Initialize an empty cache hash table.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure to initialize.
+  * - initialSize: integer, initial number of buckets (rounded up to a power of two, at least CACHE_HASH_MIN_SIZE).
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+int cacheTableInit(CacheHashTable *table, int initialSize) {
+    int size = CACHE_HASH_MIN_SIZE;
+    while (size < initialSize) {
+        size *= 2;
+    }
+    table->buckets[0] = allocBuckets(size);
+    table->buckets[1] = NULL;
+    table->size[0] = table->buckets[0] != NULL ? size : 0;
+    table->size[1] = 0;
+    table->used = 0;
+    table->rehashIndex = -1;
+    return table->buckets[0] != NULL ? 0 : -1;
+}
+
+/**
+  * Start moving the entries to a table of a new size. Does nothing if a resize is already running.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - size: integer, number of buckets of the new table.
+  */
+static void startRehash(CacheHashTable *table, int size) {
+    if (table->rehashIndex >= 0 || size == table->size[0]) {
+        return;
+    }
+    table->buckets[1] = allocBuckets(size);
+    if (table->buckets[1] == NULL) {
+        return;  //keep the current table, a longer chain is better than no cache
+    }
+    table->size[1] = size;
+    table->rehashIndex = 0;
+}
+
+/**
+  * Move up to `steps` non-empty buckets of the old table to the new one. Once the old table is empty
+  * the new table replaces it. Empty buckets are skipped, at most 10 per step, to bound the work.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - steps: integer, number of buckets to move.
+  */
+static void rehashStep(CacheHashTable *table, int steps) {
+    if (table->rehashIndex < 0) {
+        return;
+    }
+    int emptyVisits = steps * 10;
+    while (steps > 0 && table->rehashIndex < table->size[0]) {
+        CacheHashEntry *entry = table->buckets[0][table->rehashIndex];
+        if (entry == NULL) {
+            table->rehashIndex++;
+            if (--emptyVisits == 0) {
+                break;
+            }
+            continue;
+        }
+        while (entry != NULL) {
+            CacheHashEntry *next = entry->next;
+            linkEntry(&table->buckets[1][bucketOf(entry->key, table->size[1])], entry);
+            entry = next;
+        }
+        table->buckets[0][table->rehashIndex++] = NULL;
+        steps--;
+    }
+    if (table->rehashIndex >= table->size[0]) {
+        free(table->buckets[0]);
+        table->buckets[0] = table->buckets[1];
+        table->size[0] = table->size[1];
+        table->buckets[1] = NULL;
+        table->size[1] = 0;
+        table->rehashIndex = -1;
+    }
+}
+
+/**
+  * Find the entry of a key.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - key: integer, message identifier.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to the entry, or NULL if the key is not in the table.
+  */
+CacheHashEntry* cacheTableFind(CacheHashTable *table, int key) {
+    rehashStep(table, CACHE_REHASH_STEP);
+    for (int t = 0; t < 2; t++) {
+        if (table->buckets[t] == NULL) {
+            continue;
+        }
+        CacheHashEntry *current = table->buckets[t][bucketOf(key, table->size[t])];
+        while (current != NULL) {
+            if (current->key == key) {
+                return current;
+            }
+            current = current->next;
+        }
+    }
+    return NULL;
+}
+
+/**
+  * Insert an entry. The table grows once its load factor passes CACHE_HASH_MAX_LOAD.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - entry: Pointer to the CacheHashEntry to insert, its key must not be in the table.
+  */
+void cacheTableInsert(CacheHashTable *table, CacheHashEntry *entry) {
+    rehashStep(table, CACHE_REHASH_STEP);
+    // During a resize new entries go to the new table, so the old one only shrinks
+    int t = table->rehashIndex >= 0 ? 1 : 0;
+    linkEntry(&table->buckets[t][bucketOf(entry->key, table->size[t])], entry);
+    table->used++;
+    if (table->used > table->size[0] * CACHE_HASH_MAX_LOAD) {
+        startRehash(table, table->size[0] * 2);
+    }
+}
+
+/**
+  * Unlink an entry from its chain, in O(1) through its back pointer. The table shrinks once its load factor
+  * drops below CACHE_HASH_MIN_LOAD.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - entry: Pointer to a CacheHashEntry in the table, owned by the caller afterwards.
+  */
+void cacheTableUnlink(CacheHashTable *table, CacheHashEntry *entry) {
+    rehashStep(table, CACHE_REHASH_STEP);
+    *entry->pprev = entry->next;
+    if (entry->next != NULL) {
+        entry->next->pprev = entry->pprev;
+    }
+    entry->next = NULL;
+    entry->pprev = NULL;
+    table->used--;
+    if (table->size[0] > CACHE_HASH_MIN_SIZE && table->used < table->size[0] * CACHE_HASH_MIN_LOAD) {
+        startRehash(table, table->size[0] / 2);
+    }
+}
+
+/**
+  * Unlink the entry of a key.
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  * - key: integer, message identifier.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to the unlinked entry (owned by the caller), or NULL if the key is not in the table.
+  */
+CacheHashEntry* cacheTableRemove(CacheHashTable *table, int key) {
+    CacheHashEntry *entry = cacheTableFind(table, key);
+    if (entry != NULL) {
+        cacheTableUnlink(table, entry);
+    }
+    return entry;
+}
+
+/**
+  * Free the buckets. The entries are not freed, they belong to the caller (the entry slab of a cache).
+  *
+  * Parameters:
+  * - table: Pointer to CacheHashTable structure.
+  */
+void cacheTableDestroy(CacheHashTable *table) {
+    for (int t = 0; t < 2; t++) {
+        free(table->buckets[t]);
+        table->buckets[t] = NULL;
+        table->size[t] = 0;
+    }
+    table->used = 0;
+    table->rehashIndex = -1;
+}
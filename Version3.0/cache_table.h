@@ -0,0 +1,26 @@
+/*
+* cache_table.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_CACHE_TABLE_H
+#define P1_CACHE_TABLE_H
+#include "message.h"
+
+//Define the sizing of the cache hash table (see CacheHashTable in message.h)
+#define CACHE_HASH_MIN_SIZE 4
+#define CACHE_HASH_MAX_LOAD 1.0
+#define CACHE_HASH_MIN_LOAD 0.125
+//Buckets moved to the new table by every operation during a resize
+#define CACHE_REHASH_STEP 1
+
+int cacheTableInit(CacheHashTable *table, int initialSize);
+CacheHashEntry* cacheTableFind(CacheHashTable *table, int key);
+void cacheTableInsert(CacheHashTable *table, CacheHashEntry *entry);
+CacheHashEntry* cacheTableRemove(CacheHashTable *table, int key);
+void cacheTableUnlink(CacheHashTable *table, CacheHashEntry *entry);
+void cacheTableDestroy(CacheHashTable *table);
+#endif //P1_CACHE_TABLE_H
@@ -0,0 +1,377 @@
+/*
+* compaction.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "compaction.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * A compaction rewrites the message file with one record per identifier in three steps:
+ *   1. snapshot: flush the write buffer and copy the live index records (sorted by offset);
+ *   2. copy: write the live records of the snapshot to "<message file>.compact" (on a background thread);
+ *   3. finish: copy the records appended since the snapshot, write the new index next to it,
+ *      rename both over the old files and reopen the store.
+ * The copy step only reads the old file below the snapshot length, which appends never touch,
+ * so it needs no locking. rename() makes the swap atomic; the new file gets a new file id, so
+ * an index left over from the old file is never trusted.
+ */
+typedef struct CompactionJob {
+    char sourcePath[256];
+    char dataPath[272];   //new message file
+    char indexPath[272];  //new index file
+    IndexRecord *live;    //live records of the snapshot, offsets are rewritten by the copy step
+    int liveCount;
+    int deadCount;
+    int64_t snapshotLength;
+    int64_t newLength;    //length of the new file after the copy step
+    uint32_t fileId;
+    int result;
+    atomic_bool done;
+    atomic_bool cancel;
+    bool threadStarted;
+    pthread_t thread;
+} CompactionJob;
+
+/**
+  * Share of the records in the message file that are dead (replaced by a later record of the same message,
+  * so no longer referenced by the index).
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - double: Dead records divided by all records, 0 for an empty file.
+  */
+double diskStoreDeadRatio(const DiskStore *store) {
+    if (store->index.recordCount == 0) {
+        return 0.0;
+    }
+    return (double)(store->index.recordCount - store->index.count) / (double)store->index.recordCount;
+}
+
+/**
+  * Order index records by their offset in the message file.
+  */
+static int compareOffset(const void *a, const void *b) {
+    int64_t x = ((const IndexRecord*)a)->offset;
+    int64_t y = ((const IndexRecord*)b)->offset;
+    return (x > y) - (x < y);
+}
+
+/**
+  * Release a compaction job and remove its temporary files.
+  *
+  * Parameters:
+  * - job: Pointer to CompactionJob structure.
+  * - keepFiles: true if the temporary files were renamed into place.
+  */
+static void compactionFree(CompactionJob *job, bool keepFiles) {
+    if (!keepFiles) {
+        unlink(job->dataPath);
+        unlink(job->indexPath);
+    }
+    free(job->live);
+    free(job);
+}
+
+/**
+  * Step 1: flush the store and take a snapshot of its live records.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - CompactionJob*: Pointer to the new job. If the flush or memory allocation fails, NULL is returned.
+  */
+static CompactionJob* compactionSnapshot(DiskStore *store) {
+    if (diskStoreFlush(store) != 0) {
+        return NULL;
+    }
+    CompactionJob *job = (CompactionJob*)calloc(1, sizeof(CompactionJob));
+    if (job == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for CompactionJob.\n");
+        return NULL;
+    }
+    job->live = (IndexRecord*)malloc((store->index.count + 1) * sizeof(IndexRecord));
+    if (job->live == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for CompactionJob.\n");
+        free(job);
+        return NULL;
+    }
+    for (int i = 0; i < store->index.capacity; i++) {
+        if (store->index.slots[i].length != 0) {
+            job->live[job->liveCount++] = store->index.slots[i];
+        }
+    }
+    qsort(job->live, job->liveCount, sizeof(IndexRecord), compareOffset);
+
+    snprintf(job->sourcePath, sizeof(job->sourcePath), "%s", store->messagePath);
+    snprintf(job->dataPath, sizeof(job->dataPath), "%s.compact", store->messagePath);
+    snprintf(job->indexPath, sizeof(job->indexPath), "%s.compact", store->indexPath);
+    job->deadCount = store->index.recordCount - store->index.count;
+    job->snapshotLength = store->flushedLength;
+    job->fileId = generateFileId();
+    if (job->fileId == store->index.fileId) {
+        job->fileId++;
+    }
+    atomic_init(&job->done, false);
+    atomic_init(&job->cancel, false);
+    return job;
+}
+
+/**
+  * Step 2: write the live records of the snapshot to the new message file.
+  * Only reads the old file below the snapshot length, so it can run next to appends.
+  *
+  * Parameters:
+  * - job: Pointer to CompactionJob structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 on I/O error or cancellation.
+  */
+static int compactionCopy(CompactionJob *job) {
+    int source = open(job->sourcePath, O_RDONLY);
+    FILE *out = fopen(job->dataPath, "wb");
+    if (source < 0 || out == NULL) {
+        fprintf(stderr, "Error: Unable to open files for compacting %s.\n", job->sourcePath);
+        if (source >= 0) {
+            close(source);
+        }
+        if (out != NULL) {
+            fclose(out);
+        }
+        return -1;
+    }
+
+    int result = writeFileHeader(out, job->fileId);
+    int64_t offset = FILE_HEADER_SIZE;
+    unsigned char buffer[RECORD_MAX_SIZE];
+    for (int i = 0; i < job->liveCount && result == 0; i++) {
+        if (atomic_load(&job->cancel)) {
+            result = -1;
+            break;
+        }
+        IndexRecord *record = &job->live[i];
+        if (record->length > (int32_t)sizeof(buffer)
+            || pread(source, buffer, record->length, (off_t)record->offset) != record->length
+            || fwrite(buffer, record->length, 1, out) != 1) {
+            fprintf(stderr, "Error: Unable to copy message ID：%d while compacting.\n", record->identifier);
+            result = -1;
+            break;
+        }
+        record->offset = offset;
+        offset += record->length;
+    }
+    if (result == 0 && (fflush(out) != 0 || fsync(fileno(out)) != 0)) {
+        result = -1;
+    }
+    fclose(out);
+    close(source);
+    job->newLength = offset;
+    return result;
+}
+
+/**
+  * Entry point of the background compaction thread.
+  */
+static void* compactionThread(void *arg) {
+    CompactionJob *job = (CompactionJob*)arg;
+    job->result = compactionCopy(job);
+    atomic_store(&job->done, true);
+    return NULL;
+}
+
+/**
+  * Step 3: append the records written since the snapshot, write the new index, swap the files
+  * into place and reopen the active segment.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - job: Pointer to a CompactionJob whose copy step succeeded.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure (the old files are left untouched).
+  */
+static int compactionFinish(DiskStore *store, CompactionJob *job) {
+    if (diskStoreFlush(store) != 0) {
+        return -1;
+    }
+
+    // Records appended after the snapshot are all live. One that replaces a record of the snapshot
+    // comes after it in the new index, so the index file loads it last and the copied one stays dead
+    int tailCount = 0;
+    for (int i = 0; i < store->index.capacity; i++) {
+        if (store->index.slots[i].length != 0 && store->index.slots[i].offset >= job->snapshotLength) {
+            tailCount++;
+        }
+    }
+    IndexRecord *records = (IndexRecord*)realloc(job->live, (job->liveCount + tailCount + 1) * sizeof(IndexRecord));
+    if (records == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for CompactionJob.\n");
+        return -1;
+    }
+    job->live = records;
+    int count = job->liveCount;
+    for (int i = 0; i < store->index.capacity; i++) {
+        IndexRecord record = store->index.slots[i];
+        if (record.length != 0 && record.offset >= job->snapshotLength) {
+            record.offset = job->newLength + (record.offset - job->snapshotLength);
+            records[count++] = record;
+        }
+    }
+    qsort(records + job->liveCount, tailCount, sizeof(IndexRecord), compareOffset);
+
+    int source = open(job->sourcePath, O_RDONLY);
+    int out = open(job->dataPath, O_WRONLY | O_APPEND);
+    int result = (source >= 0 && out >= 0) ? 0 : -1;
+    unsigned char buffer[64 * 1024];
+    for (int64_t position = job->snapshotLength; result == 0 && position < store->flushedLength;) {
+        size_t chunk = sizeof(buffer);
+        if ((int64_t)chunk > store->flushedLength - position) {
+            chunk = (size_t)(store->flushedLength - position);
+        }
+        ssize_t n = pread(source, buffer, chunk, (off_t)position);
+        if (n <= 0 || write(out, buffer, (size_t)n) != n) {
+            result = -1;
+            break;
+        }
+        position += n;
+    }
+    if (result == 0 && fsync(out) != 0) {
+        result = -1;
+    }
+    if (source >= 0) {
+        close(source);
+    }
+    if (out >= 0) {
+        close(out);
+    }
+    if (result != 0 || diskIndexWriteFile(job->indexPath, job->fileId, records, count) != 0) {
+        fprintf(stderr, "Error: Unable to finish compacting %s.\n", job->sourcePath);
+        return -1;
+    }
+
+    // The data file goes first: if we stop in between, the old index has the wrong file id and is rebuilt
+    if (rename(job->dataPath, store->messagePath) != 0) {
+        fprintf(stderr, "Error: Unable to replace %s with its compacted copy.\n", store->messagePath);
+        return -1;
+    }
+    // The old file is unlinked now, so the store must move to the new one even if its index stays behind
+    if (rename(job->indexPath, store->indexPath) != 0) {
+        fprintf(stderr, "Warning: Unable to replace %s, it is rebuilt from %s.\n", store->indexPath, store->messagePath);
+        unlink(job->indexPath);
+    }
+
+    if (diskStoreReopenActive(store) != 0) {
+        return -1;
+    }
+
+    printf("Compaction removed %d dead records from %s\n", job->deadCount, store->messagePath);
+    return 0;
+}
+
+/**
+  * Compact the message file in the calling thread (offline compaction).
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure.
+  */
+int diskStoreCompact(DiskStore *store) {
+    compactionAbort(store);
+    CompactionJob *job = compactionSnapshot(store);
+    if (job == NULL) {
+        return -1;
+    }
+    int result = compactionCopy(job);
+    if (result == 0) {
+        result = compactionFinish(store, job);
+    }
+    compactionFree(job, result == 0);
+    return result;
+}
+
+/**
+  * Start compacting the message file on a background thread. The store keeps serving reads and appends;
+  * the new file is swapped in by compactionMaintain once the copy is done.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 if the compaction started, -1 if one is already running or it could not be started.
+  */
+int compactionStart(DiskStore *store) {
+    if (store->compaction != NULL) {
+        return -1;
+    }
+    CompactionJob *job = compactionSnapshot(store);
+    if (job == NULL) {
+        return -1;
+    }
+    if (pthread_create(&job->thread, NULL, compactionThread, job) != 0) {
+        fprintf(stderr, "Error: Unable to start the compaction thread.\n");
+        compactionFree(job, false);
+        return -1;
+    }
+    job->threadStarted = true;
+    store->compaction = job;
+    return 0;
+}
+
+/**
+  * Called on every disk access: finishes a background compaction whose copy step is done,
+  * or starts one when the dead-record ratio passes store->compactDeadRatio.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  */
+void compactionMaintain(DiskStore *store) {
+    CompactionJob *job = store->compaction;
+    if (job != NULL) {
+        if (!atomic_load(&job->done)) {
+            return;
+        }
+        pthread_join(job->thread, NULL);
+        store->compaction = NULL;
+        int result = job->result == 0 ? compactionFinish(store, job) : -1;
+        compactionFree(job, result == 0);
+        return;
+    }
+    if (store->compactDeadRatio > 0 && store->index.recordCount >= COMPACT_MIN_RECORDS
+        && diskStoreDeadRatio(store) >= store->compactDeadRatio) {
+        compactionStart(store);
+    }
+}
+
+/**
+  * Stop a background compaction and discard its output.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  */
+void compactionAbort(DiskStore *store) {
+    CompactionJob *job = store->compaction;
+    if (job == NULL) {
+        return;
+    }
+    store->compaction = NULL;
+    atomic_store(&job->cancel, true);
+    if (job->threadStarted) {
+        pthread_join(job->thread, NULL);
+    }
+    compactionFree(job, false);
+}
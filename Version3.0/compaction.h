@@ -0,0 +1,18 @@
+/*
+* compaction.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_COMPACTION_H
+#define P1_COMPACTION_H
+#include "disk_store.h"
+
+double diskStoreDeadRatio(const DiskStore *store);
+int diskStoreCompact(DiskStore *store);
+int compactionStart(DiskStore *store);
+void compactionMaintain(DiskStore *store);
+void compactionAbort(DiskStore *store);
+#endif //P1_COMPACTION_H
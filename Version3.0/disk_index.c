@@ -0,0 +1,346 @@
+/*
+* disk_index.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "disk_index.h"
+#include "record.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_INITIAL_CAPACITY 1024
+
+//Header at the start of the index file
+typedef struct IndexHeader {
+    char magic[8];
+    int32_t version;
+    uint32_t fileId;
+} IndexHeader;
+
+/**
+  * Hash an identifier to a slot of the index table.
+  *
+  * Parameters:
+  * - identifier: integer, message identifier.
+  * - capacity: integer, table capacity (a power of two).
+  *
+  * return value:
+  * - int: Slot where the probe sequence of the identifier starts.
+  */
+static int indexSlot(int identifier, int capacity) {
+    uint32_t h = (uint32_t)identifier * 2654435761u;
+    return (int)(h & (uint32_t)(capacity - 1));
+}
+
+/**
+  * Put a record into the in-memory table without touching the index file.
+  * The latest record of an identifier wins: a message stored again replaces its earlier record.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  * - record: Pointer to the record to insert.
+  *
+  * return value:
+  * - int: 1 if inserted, 0 if it replaced the record of an indexed identifier, -1 if memory allocation failed.
+  */
+static int indexTablePut(DiskIndex *index, const IndexRecord *record) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        int newCapacity = index->capacity * 2;
+        IndexRecord *newSlots = (IndexRecord*)calloc(newCapacity, sizeof(IndexRecord));
+        if (newSlots == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for DiskIndex.\n");
+            return -1;
+        }
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->slots[i].length == 0) {
+                continue;
+            }
+            int slot = indexSlot(index->slots[i].identifier, newCapacity);
+            while (newSlots[slot].length != 0) {
+                slot = (slot + 1) & (newCapacity - 1);
+            }
+            newSlots[slot] = index->slots[i];
+        }
+        free(index->slots);
+        index->slots = newSlots;
+        index->capacity = newCapacity;
+    }
+
+    int slot = indexSlot(record->identifier, index->capacity);
+    while (index->slots[slot].length != 0) {
+        if (index->slots[slot].identifier == record->identifier) {
+            index->slots[slot] = *record;
+            return 0;
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    index->slots[slot] = *record;
+    index->count++;
+    return 1;
+}
+
+/**
+  * Truncate the index file and write a fresh header.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  * - indexPath: string, path of the index file.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the file could not be created.
+  */
+static int indexFileReset(DiskIndex *index, const char *indexPath) {
+    if (index->indexFile != NULL) {
+        fclose(index->indexFile);
+    }
+    index->indexFile = fopen(indexPath, "w+b");
+    if (index->indexFile == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", indexPath);
+        return -1;
+    }
+    IndexHeader header = { .version = INDEX_VERSION, .fileId = index->fileId };
+    strncpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, index->indexFile);
+    fflush(index->indexFile);
+    return 0;
+}
+
+/**
+  * Index the records of the message file that come after index->coveredLength.
+  * This is how records written without the index (or by an older build) get picked up.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  * - messagePath: string, path of the message file.
+  */
+static void indexCatchUp(DiskIndex *index, const char *messagePath) {
+    FILE *file = fopen(messagePath, "rb");
+    if (file == NULL) {
+        return;
+    }
+    if (index->coveredLength < FILE_HEADER_SIZE) {
+        index->coveredLength = FILE_HEADER_SIZE;
+    }
+    if (fseek(file, (long)index->coveredLength, SEEK_SET) != 0) {
+        fclose(file);
+        return;
+    }
+
+    struct stat st;
+    int64_t messageLength = fstat(fileno(file), &st) == 0 ? (int64_t)st.st_size : 0;
+
+    // Only the record headers are read, the rest of each record is skipped.
+    // A truncated record at the end (torn append) stops the scan.
+    unsigned char header[RECORD_HEADER_SIZE];
+    int64_t offset = index->coveredLength;
+    while (fread(header, sizeof(header), 1, file) == 1) {
+        uint32_t length = recordLength(header);
+        if (length < RECORD_HEADER_SIZE || length > RECORD_MAX_SIZE || offset + length > messageLength
+            || fseek(file, (long)(offset + length), SEEK_SET) != 0) {
+            break;
+        }
+        diskIndexInsert(index, recordIdentifier(header), offset, (int32_t)length);
+        offset += length;
+    }
+    index->coveredLength = offset;
+    fclose(file);
+}
+
+/**
+  * Open the persistent index of the message file, load it into memory and bring it up to date.
+  * A missing, corrupt or stale index file, or one written for another message file, is rebuilt from the message file.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure to initialize.
+  * - messagePath: string, path of the message file.
+  * - indexPath: string, path of the index file.
+  * - fileId: id from the header of the message file.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed. When the index file cannot be written, the index still works in memory.
+  */
+int diskIndexOpen(DiskIndex *index, const char *messagePath, const char *indexPath, uint32_t fileId) {
+    index->capacity = INDEX_INITIAL_CAPACITY;
+    index->count = 0;
+    index->recordCount = 0;
+    index->fileId = fileId;
+    index->coveredLength = 0;
+    index->indexFile = NULL;
+    index->slots = (IndexRecord*)calloc(index->capacity, sizeof(IndexRecord));
+    if (index->slots == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for DiskIndex.\n");
+        return -1;
+    }
+
+    struct stat st;
+    int64_t messageLength = stat(messagePath, &st) == 0 ? (int64_t)st.st_size : 0;
+
+    // Load the existing index file if its header is valid
+    bool valid = false;
+    index->indexFile = fopen(indexPath, "r+b");
+    if (index->indexFile != NULL) {
+        IndexHeader header;
+        if (fread(&header, sizeof(header), 1, index->indexFile) == 1
+            && strncmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) == 0
+            && header.version == INDEX_VERSION
+            && header.fileId == fileId) {
+            valid = true;
+            IndexRecord record;
+            while (fread(&record, sizeof(record), 1, index->indexFile) == 1) {
+                if (record.length <= 0 || record.offset + record.length > messageLength) {
+                    // The message file was truncated or replaced, the index no longer describes it
+                    valid = false;
+                    break;
+                }
+                indexTablePut(index, &record);
+                index->recordCount++;
+                if (record.offset + record.length > index->coveredLength) {
+                    index->coveredLength = record.offset + record.length;
+                }
+            }
+        }
+    }
+
+    if (!valid) {
+        memset(index->slots, 0, index->capacity * sizeof(IndexRecord));
+        index->count = 0;
+        index->recordCount = 0;
+        index->coveredLength = 0;
+        indexFileReset(index, indexPath);
+    } else {
+        // Cut a record that was only partly appended, so the next record starts on a record boundary
+        long end = (long)sizeof(IndexHeader) + (long)index->recordCount * (long)sizeof(IndexRecord);
+        fflush(index->indexFile);
+        if (ftruncate(fileno(index->indexFile), (off_t)end) != 0) {
+            fprintf(stderr, "Warning: Unable to truncate %s, its next record overwrites the incomplete one.\n", indexPath);
+        }
+        fseek(index->indexFile, end, SEEK_SET);
+    }
+
+    indexCatchUp(index, messagePath);
+    if (index->indexFile != NULL) {
+        fflush(index->indexFile);
+    }
+    return 0;
+}
+
+/**
+  * Look up the position of a message in the message file.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  * - identifier: integer, identifier of the message.
+  * - record: Pointer that receives the index record, may be NULL.
+  *
+  * return value:
+  * - bool: true if the message is on disk.
+  */
+bool diskIndexLookup(const DiskIndex *index, int identifier, IndexRecord *record) {
+    int slot = indexSlot(identifier, index->capacity);
+    while (index->slots[slot].length != 0) {
+        if (index->slots[slot].identifier == identifier) {
+            if (record != NULL) {
+                *record = index->slots[slot];
+            }
+            return true;
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return false;
+}
+
+/**
+  * Record that a message was appended to the message file, in memory and in the index file.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  * - identifier: integer, identifier of the message.
+  * - offset: byte offset of the record in the message file.
+  * - length: length of the record in bytes.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure.
+  */
+int diskIndexInsert(DiskIndex *index, int identifier, int64_t offset, int32_t length) {
+    IndexRecord record = { .identifier = identifier, .length = length, .offset = offset };
+    if (indexTablePut(index, &record) < 0) {
+        return -1;
+    }
+    index->recordCount++;
+    if (offset + length > index->coveredLength) {
+        index->coveredLength = offset + length;
+    }
+
+    // Replaced records are written too, in file order, so the next open loads the latest one last.
+    // The record stays in the stdio buffer until diskIndexFlush, a stale index is rebuilt on open.
+    if (index->indexFile != NULL) {
+        if (fwrite(&record, sizeof(record), 1, index->indexFile) != 1) {
+            fprintf(stderr, "Error: Unable to write to the index file.\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+  * Write the buffered index records to the index file.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  */
+void diskIndexFlush(DiskIndex *index) {
+    if (index->indexFile != NULL) {
+        fflush(index->indexFile);
+    }
+}
+
+/**
+  * Write a complete index file for a set of records, e.g. for a message file produced by compaction.
+  *
+  * Parameters:
+  * - indexPath: string, path of the index file to create (replaced if it exists).
+  * - fileId: id of the message file the records belong to.
+  * - records: array of index records.
+  * - count: number of records.
+  *
+  * return value:
+  * - int: 0 on success, -1 on write failure.
+  */
+int diskIndexWriteFile(const char *indexPath, uint32_t fileId, const IndexRecord *records, int count) {
+    FILE *file = fopen(indexPath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", indexPath);
+        return -1;
+    }
+    IndexHeader header = { .version = INDEX_VERSION, .fileId = fileId };
+    strncpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+              && (count == 0 || fwrite(records, sizeof(IndexRecord), count, file) == (size_t)count);
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error: Unable to write file %s.\n", indexPath);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Flush and close the index file and release the in-memory table.
+  *
+  * Parameters:
+  * - index: Pointer to DiskIndex structure.
+  */
+void diskIndexClose(DiskIndex *index) {
+    if (index->indexFile != NULL) {
+        fclose(index->indexFile);
+        index->indexFile = NULL;
+    }
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
@@ -0,0 +1,42 @@
+/*
+* disk_index.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_DISK_INDEX_H
+#define P1_DISK_INDEX_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+//Define the header of the persistent index file
+#define INDEX_MAGIC "P1IDX"
+#define INDEX_VERSION 2
+
+//One record of the index file: the record of `identifier` starts at `offset` and is `length` bytes long
+typedef struct IndexRecord {
+    int32_t identifier;
+    int32_t length;
+    int64_t offset;
+} IndexRecord;
+
+typedef struct DiskIndex {
+    IndexRecord *slots; //open addressing table, empty slots have length 0
+    int capacity;       //always a power of two
+    int count;             //identifiers in the table (live records)
+    int recordCount;       //records in the message file, duplicates included
+    uint32_t fileId;       //id of the message file the index describes
+    int64_t coveredLength; //bytes of the message file described by the index
+    FILE *indexFile;       //kept open for appending new records
+} DiskIndex;
+
+int diskIndexOpen(DiskIndex *index, const char *messagePath, const char *indexPath, uint32_t fileId);
+int diskIndexWriteFile(const char *indexPath, uint32_t fileId, const IndexRecord *records, int count);
+bool diskIndexLookup(const DiskIndex *index, int identifier, IndexRecord *record);
+int diskIndexInsert(DiskIndex *index, int identifier, int64_t offset, int32_t length);
+void diskIndexFlush(DiskIndex *index);
+void diskIndexClose(DiskIndex *index);
+#endif //P1_DISK_INDEX_H
@@ -0,0 +1,843 @@
+/*
+* disk_store.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "disk_store.h"
+#include "record.h"
+#include "compaction.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+  * Release the mapping of the message file and its descriptor.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  */
+static void diskStoreUnmap(DiskStore *store) {
+    if (store->map != NULL) {
+        munmap(store->map, store->mapLength);
+        store->map = NULL;
+        store->mapLength = 0;
+        store->mappedFileLength = 0;
+    }
+    if (store->readFd >= 0) {
+        close(store->readFd);
+        store->readFd = -1;
+    }
+}
+
+/**
+  * Make sure the first `length` bytes of the message file can be read through the mapping.
+  * The mapping reserves room for the file to double, and pages past the end of the file become
+  * readable as the file grows, so a growing file only needs an fstat until it outgrows the reservation.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - length: number of bytes from the start of the file that must be readable.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the file could not be mapped.
+  */
+static int diskStoreMap(DiskStore *store, size_t length) {
+    if (store->map != NULL && length <= store->mappedFileLength) {
+        return 0;
+    }
+    if (store->readFd < 0) {
+        store->readFd = open(store->messagePath, O_RDONLY);
+        if (store->readFd < 0) {
+            fprintf(stderr, "Error: Unable to open file %s for reading.\n", store->messagePath);
+            return -1;
+        }
+    }
+    struct stat st;
+    if (fstat(store->readFd, &st) != 0 || (size_t)st.st_size < length) {
+        return -1;
+    }
+    if (store->map != NULL && (size_t)st.st_size <= store->mapLength) {
+        store->mappedFileLength = (size_t)st.st_size;
+        return 0;
+    }
+
+    size_t mapLength = MIN_MAP_LENGTH;
+    while (mapLength < (size_t)st.st_size * 2) {
+        mapLength *= 2;
+    }
+    if (store->map != NULL) {
+        munmap(store->map, store->mapLength);
+        store->map = NULL;
+        store->mapLength = 0;
+        store->mappedFileLength = 0;
+    }
+    void *map = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, store->readFd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Unable to map file %s.\n", store->messagePath);
+        return -1;
+    }
+    store->map = (unsigned char*)map;
+    store->mapLength = mapLength;
+    store->mappedFileLength = (size_t)st.st_size;
+    return 0;
+}
+
+/**
+  * Rebuild the Bloom filter from the index, sized for twice the identifiers on disk.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - falsePositiveRate: target false-positive rate of the filter.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure (the previous filter is kept).
+  */
+static int diskStoreRebuildBloom(DiskStore *store, double falsePositiveRate) {
+    BloomFilter bloom;
+    if (bloomInit(&bloom, (uint64_t)store->index.count * 2, falsePositiveRate) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < store->index.capacity; i++) {
+        if (store->index.slots[i].length != 0) {
+            bloomAdd(&bloom, store->index.slots[i].identifier);
+        }
+    }
+    bloomFree(&store->bloom);
+    store->bloom = bloom;
+    return 0;
+}
+
+/**
+  * Open the active segment (the message file) and its index. An empty or missing file gets a fresh header.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure whose paths and settings are set.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the file is not a message file of the supported version or cannot be opened.
+  */
+static int activeOpen(DiskStore *store) {
+    const char *messagePath = store->messagePath;
+    store->readFd = -1;
+    store->map = NULL;
+    store->mapLength = 0;
+    store->mappedFileLength = 0;
+    store->bloom = (BloomFilter){0};
+    store->writeFd = -1;
+    store->writeBuffer = NULL;
+    store->writeBufferSize = 0;
+    store->writeBufferUsed = 0;
+    store->firstBufferedMs = 0;
+    store->lastSyncMs = current_timestamp_ms();
+    store->syncPending = false;
+
+    FILE *file = fopen(messagePath, "a+b");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s.\n", messagePath);
+        return -1;
+    }
+    unsigned char header[FILE_HEADER_SIZE];
+    size_t headerLength = fread(header, 1, sizeof(header), file);
+    uint32_t fileId;
+    if (headerLength == 0) {
+        fileId = generateFileId();
+        writeFileHeader(file, fileId);
+    } else if (checkFileHeader(header, headerLength) != 0) {
+        fprintf(stderr, "Error: %s is not a message file of version %d.\n", messagePath, FILE_VERSION);
+        fclose(file);
+        return -1;
+    } else {
+        fileId = fileHeaderId(header);
+    }
+    fclose(file);
+
+    if (diskIndexOpen(&store->index, messagePath, store->indexPath, fileId) != 0) {
+        return -1;
+    }
+
+    // Drop a record that was only partly written, so the next append starts on a record boundary
+    struct stat st;
+    if (stat(messagePath, &st) == 0 && st.st_size > store->index.coveredLength) {
+        fprintf(stderr, "Warning: dropping %lld bytes of incomplete record at the end of %s.\n",
+                (long long)(st.st_size - store->index.coveredLength), messagePath);
+        if (truncate(messagePath, (off_t)store->index.coveredLength) != 0) {
+            fprintf(stderr, "Error: Unable to truncate %s.\n", messagePath);
+        }
+    }
+
+    store->flushedLength = store->index.coveredLength;
+
+    if (diskStoreRebuildBloom(store, store->falsePositiveRate) != 0) {
+        diskIndexClose(&store->index);
+        return -1;
+    }
+    store->writeFd = open(messagePath, O_WRONLY | O_APPEND);
+    store->writeBufferSize = store->writer.flushBytes + RECORD_MAX_SIZE;
+    store->writeBuffer = (unsigned char*)malloc(store->writeBufferSize);
+    if (store->writeFd < 0 || store->writeBuffer == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", messagePath);
+        if (store->writeFd >= 0) {
+            close(store->writeFd);
+            store->writeFd = -1;
+        }
+        free(store->writeBuffer);
+        store->writeBuffer = NULL;
+        bloomFree(&store->bloom);
+        diskIndexClose(&store->index);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Flush and close the active segment. Buffered records are synced unless durability is DURABILITY_NONE.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  */
+static void activeClose(DiskStore *store) {
+    if (store->writeFd >= 0) {
+        diskStoreFlush(store);
+        if (store->syncPending && store->writer.durability != DURABILITY_NONE) {
+            fsync(store->writeFd);
+        }
+        close(store->writeFd);
+        store->writeFd = -1;
+    }
+    free(store->writeBuffer);
+    store->writeBuffer = NULL;
+    store->writeBufferUsed = 0;
+    diskStoreUnmap(store);
+    bloomFree(&store->bloom);
+    diskIndexClose(&store->index);
+}
+
+/**
+  * Order segments by sequence number.
+  */
+static int compareSequence(const void *a, const void *b) {
+    return ((const Segment*)a)->sequence - ((const Segment*)b)->sequence;
+}
+
+/**
+  * Find and open the sealed segments next to the message file ("<message file>.<6-digit sequence>").
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 if a segment could not be opened or memory allocation failed.
+  */
+static int diskStoreLoadSegments(DiskStore *store) {
+    char directory[256] = ".";
+    const char *name = store->messagePath;
+    const char *slash = strrchr(store->messagePath, '/');
+    if (slash != NULL) {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - store->messagePath), store->messagePath);
+        name = slash + 1;
+    }
+    size_t nameLength = strlen(name);
+
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return 0;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *suffix = entry->d_name + nameLength;
+        if (strncmp(entry->d_name, name, nameLength) != 0 || suffix[0] != '.' || strlen(suffix) != 7
+            || strspn(suffix + 1, "0123456789") != 6) {
+            continue;
+        }
+        Segment *segments = (Segment*)realloc(store->segments, (store->segmentCount + 1) * sizeof(Segment));
+        if (segments == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for Segment.\n");
+            result = -1;
+            break;
+        }
+        store->segments = segments;
+        char path[272];
+        snprintf(path, sizeof(path), "%s%s", store->messagePath, suffix);
+        int sequence = atoi(suffix + 1);
+        if (segmentOpen(&store->segments[store->segmentCount], path, sequence) != 0) {
+            result = -1;
+            break;
+        }
+        store->segmentCount++;
+        if (sequence >= store->nextSequence) {
+            store->nextSequence = sequence + 1;
+        }
+    }
+    closedir(dir);
+    if (store->segmentCount > 1) {
+        qsort(store->segments, store->segmentCount, sizeof(Segment), compareSequence);
+    }
+    return result;
+}
+
+/**
+  * Open the message store: the sealed segments and the active segment with its index.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure to initialize.
+  * - messagePath: string, path of the message file (the active segment).
+  * - indexPath: string, path of the index file of the active segment.
+  *
+  * return value:
+  * - int: 0 on success, -1 if a file is not of the supported version or cannot be opened.
+  */
+int diskStoreOpen(DiskStore *store, const char *messagePath, const char *indexPath) {
+    strncpy(store->messagePath, messagePath, sizeof(store->messagePath));
+    store->messagePath[sizeof(store->messagePath) - 1] = '\0';
+    strncpy(store->indexPath, indexPath, sizeof(store->indexPath));
+    store->indexPath[sizeof(store->indexPath) - 1] = '\0';
+    store->readMode = DEFAULT_READ_MODE;
+    store->writer = (WriterConfig){ DEFAULT_FLUSH_BYTES, DEFAULT_FLUSH_INTERVAL_MS, DEFAULT_DURABILITY, DEFAULT_SYNC_INTERVAL_MS };
+    store->falsePositiveRate = BLOOM_FALSE_POSITIVE_RATE;
+    store->compactDeadRatio = COMPACT_DEAD_RATIO;
+    store->segmentMaxBytes = SEGMENT_MAX_BYTES;
+    store->compressSegments = DEFAULT_COMPRESS_SEGMENTS;
+    store->segments = NULL;
+    store->segmentCount = 0;
+    store->nextSequence = 1;
+    store->compaction = NULL;
+
+    if (diskStoreLoadSegments(store) != 0 || activeOpen(store) != 0) {
+        for (int i = 0; i < store->segmentCount; i++) {
+            segmentClose(&store->segments[i]);
+        }
+        free(store->segments);
+        store->segments = NULL;
+        store->segmentCount = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+  * Close and reopen the active segment, e.g. after its file was replaced. Settings are kept.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the active segment could not be opened again.
+  */
+int diskStoreReopenActive(DiskStore *store) {
+    activeClose(store);
+    return activeOpen(store);
+}
+
+/**
+  * Choose how disk hits are read.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - mode: DISK_READ_STDIO or DISK_READ_MMAP.
+  */
+void diskStoreSetReadMode(DiskStore *store, DiskReadMode mode) {
+    if (mode != DISK_READ_MMAP) {
+        diskStoreUnmap(store);
+    }
+    store->readMode = mode;
+}
+
+/**
+  * Change the false-positive rate of the Bloom filter in front of the index. The filter is rebuilt;
+  * segments sealed from now on use the new rate too.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - falsePositiveRate: target false-positive rate, between 0 and 1.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the rate is invalid or memory allocation failed.
+  */
+int diskStoreSetFalsePositiveRate(DiskStore *store, double falsePositiveRate) {
+    if (diskStoreRebuildBloom(store, falsePositiveRate) != 0) {
+        return -1;
+    }
+    store->falsePositiveRate = falsePositiveRate;
+    return 0;
+}
+
+/**
+  * Change the group-commit settings. Buffered records are flushed first.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - config: Pointer to the new WriterConfig.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the flush failed or memory allocation failed.
+  */
+int diskStoreSetWriterConfig(DiskStore *store, const WriterConfig *config) {
+    if (diskStoreFlush(store) != 0) {
+        return -1;
+    }
+    size_t bufferSize = config->flushBytes + RECORD_MAX_SIZE;
+    unsigned char *buffer = (unsigned char*)realloc(store->writeBuffer, bufferSize);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the write buffer.\n");
+        return -1;
+    }
+    store->writeBuffer = buffer;
+    store->writeBufferSize = bufferSize;
+    store->writer = *config;
+    return 0;
+}
+
+/**
+  * Write all buffered records to the message file in one batch, then fsync according to the durability mode.
+  * The index records of the batch are flushed after the data, so the index file never runs ahead of it for long.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 on write or fsync failure (the unwritten records stay buffered).
+  */
+int diskStoreFlush(DiskStore *store) {
+    size_t written = 0;
+    while (written < store->writeBufferUsed) {
+        ssize_t n = write(store->writeFd, store->writeBuffer + written, store->writeBufferUsed - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Error: Unable to write to %s.\n", store->messagePath);
+            memmove(store->writeBuffer, store->writeBuffer + written, store->writeBufferUsed - written);
+            store->writeBufferUsed -= written;
+            store->flushedLength += (int64_t)written;
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    if (written > 0) {
+        store->syncPending = true;
+    }
+    store->flushedLength += (int64_t)written;
+    store->writeBufferUsed = 0;
+
+    long long now = current_timestamp_ms();
+    if (store->syncPending && (store->writer.durability == DURABILITY_BATCH
+        || (store->writer.durability == DURABILITY_PERIODIC && now - store->lastSyncMs >= store->writer.syncIntervalMs))) {
+        if (fsync(store->writeFd) != 0) {
+            fprintf(stderr, "Error: Unable to fsync %s.\n", store->messagePath);
+            return -1;
+        }
+        store->syncPending = false;
+        store->lastSyncMs = now;
+    }
+    diskIndexFlush(&store->index);
+    return 0;
+}
+
+/**
+  * Check whether a message is in the active segment: Bloom filter first, then the index.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - identifier: integer, identifier of the message.
+  * - record: Pointer that receives the index record, may be NULL.
+  *
+  * return value:
+  * - bool: true if the message is in the active segment.
+  */
+static bool activeLookup(DiskStore *store, int identifier, IndexRecord *record) {
+    if (!bloomMayContain(&store->bloom, identifier)) {
+        return false;
+    }
+    return diskIndexLookup(&store->index, identifier, record);
+}
+
+/**
+  * Check whether a message is on disk, without reading the message files in most cases.
+  * The active segment is checked first, then only the sealed segments whose identifier range
+  * and Bloom filter admit the identifier.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - identifier: integer, identifier of the message.
+  *
+  * return value:
+  * - bool: true if the message is on disk.
+  */
+bool diskStoreContains(DiskStore *store, int identifier) {
+    if (activeLookup(store, identifier, NULL)) {
+        return true;
+    }
+    for (int i = store->segmentCount - 1; i >= 0; i--) {
+        if (segmentFind(&store->segments[i], identifier, NULL) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+  * Read a record of the active segment. In mmap mode the record is decoded straight out of the mapping,
+  * otherwise it costs one seek and one record read.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - record: Pointer to the index record of the message.
+  * - msg: Pointer to the Message structure that receives the message.
+  *
+  * return value:
+  * - int: 1 if the message was read, -1 on I/O error or corrupt record.
+  */
+static int activeRead(DiskStore *store, const IndexRecord *record, Message *msg) {
+    int identifier = record->identifier;
+
+    // The record was appended but is still waiting in the write buffer
+    if (record->offset >= store->flushedLength) {
+        const unsigned char *start = store->writeBuffer + (record->offset - store->flushedLength);
+        if (decodeRecord(start, record->length, msg) == record->length && msg->identifier == identifier) {
+            return 1;
+        }
+        return -1;
+    }
+
+    if (store->readMode == DISK_READ_MMAP && diskStoreMap(store, (size_t)(record->offset + record->length)) == 0) {
+        const unsigned char *start = store->map + record->offset;
+        if (decodeRecord(start, record->length, msg) == record->length && msg->identifier == identifier) {
+            return 1;
+        }
+        fprintf(stderr, "Error: Corrupt record of message ID：%d in %s.\n", identifier, store->messagePath);
+        return -1;
+    }
+
+    unsigned char buffer[RECORD_MAX_SIZE];
+    if (record->length > (int32_t)sizeof(buffer)) {
+        return -1;
+    }
+    FILE *file = fopen(store->messagePath, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", store->messagePath);
+        return -1;
+    }
+    int result = -1;
+    if (fseek(file, (long)record->offset, SEEK_SET) == 0
+        && fread(buffer, record->length, 1, file) == 1
+        && decodeRecord(buffer, record->length, msg) == record->length
+        && msg->identifier == identifier) {
+        result = 1;
+    } else {
+        fprintf(stderr, "Error: Corrupt record of message ID：%d in %s.\n", identifier, store->messagePath);
+    }
+    fclose(file);
+    return result;
+}
+
+/**
+  * Read a message from disk: the active segment first, then the candidate sealed segments, newest first.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - identifier: integer, identifier of the message.
+  * - msg: Pointer to the Message structure that receives the message.
+  *
+  * return value:
+  * - int: 1 if the message was read, 0 if it is not on disk, -1 on I/O error or corrupt record.
+  */
+int diskStoreRead(DiskStore *store, int identifier, Message *msg) {
+    compactionMaintain(store);
+    IndexRecord record;
+    if (activeLookup(store, identifier, &record)) {
+        return activeRead(store, &record, msg);
+    }
+    for (int i = store->segmentCount - 1; i >= 0; i--) {
+        int result = segmentFind(&store->segments[i], identifier, msg);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+/**
+  * Find where the bytes of a message are, so that they can be read without going through the store
+  * (e.g. asynchronously). The span is a single record of the active segment, or the range of a sealed
+  * segment that can hold the message; segmentScanSpan finds the message in the bytes read.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - identifier: integer, identifier of the message.
+  * - span: Pointer to the DiskSpan structure that receives the location.
+  *
+  * return value:
+  * - int: DISK_LOCATED if span was filled, DISK_NOT_FOUND if the message is not on disk,
+  *        DISK_IN_MEMORY if it is still in the write buffer (read it with diskStoreRead), -1 on error.
+  */
+int diskStoreLocate(DiskStore *store, int identifier, DiskSpan *span) {
+    compactionMaintain(store);
+    IndexRecord record;
+    if (activeLookup(store, identifier, &record)) {
+        if (record.offset >= store->flushedLength) {
+            return DISK_IN_MEMORY;
+        }
+        if (store->readFd < 0) {
+            store->readFd = open(store->messagePath, O_RDONLY);
+            if (store->readFd < 0) {
+                fprintf(stderr, "Error: Unable to open file %s for reading.\n", store->messagePath);
+                return -1;
+            }
+        }
+        *span = (DiskSpan){ .fd = store->readFd, .offset = record.offset, .length = record.length, .compressed = false };
+        return DISK_LOCATED;
+    }
+    for (int i = store->segmentCount - 1; i >= 0; i--) {
+        Segment *segment = &store->segments[i];
+        int result = segmentSpan(segment, identifier, &span->offset, &span->length);
+        if (result == 1) {
+            span->fd = segment->fd;
+            span->compressed = (segment->footer.flags & SEGMENT_COMPRESSED) != 0;
+            return DISK_LOCATED;
+        }
+        if (result < 0) {
+            return -1;
+        }
+    }
+    return DISK_NOT_FOUND;
+}
+
+/**
+  * Whether two messages would be stored as the same record (string fields as encodeRecord cuts them).
+  */
+static bool sameRecord(const Message *a, const Message *b) {
+    return a->identifier == b->identifier && a->time_sent == b->time_sent && a->delivered == b->delivered
+           && strncmp(a->sender, b->sender, sizeof(a->sender) - 1) == 0
+           && strncmp(a->receiver, b->receiver, sizeof(a->receiver) - 1) == 0
+           && strncmp(a->content, b->content, sizeof(a->content) - 1) == 0;
+}
+
+/**
+  * Append a message to the message file unless the same message is already on disk.
+  * A message stored again with other fields (e.g. now delivered) gets a new record that the index points to;
+  * the record it replaces stays in the file, dead, until compaction drops it.
+  * The record goes to the write buffer, which is flushed once it holds writer.flushBytes bytes
+  * or its oldest record is writer.flushIntervalMs old.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - msg: Pointer to the Message structure to write.
+  *
+  * return value:
+  * - int: 1 if the message was appended, 0 if it was already on disk unchanged, -1 on failure.
+  */
+int diskStoreAppend(DiskStore *store, const Message *msg) {
+    compactionMaintain(store);
+    bool inActive = activeLookup(store, msg->identifier, NULL);
+    if (inActive || diskStoreContains(store, msg->identifier)) {
+        Message stored;
+        int found = diskStoreRead(store, msg->identifier, &stored);
+        if (found < 0) {
+            return -1;
+        }
+        if (found == 1 && sameRecord(msg, &stored)) {
+            return 0;
+        }
+    }
+
+    long long now = current_timestamp_ms();
+    if (store->writeBufferUsed > 0 && now - store->firstBufferedMs >= store->writer.flushIntervalMs) {
+        diskStoreFlush(store);
+    }
+    if (store->writeBufferSize - store->writeBufferUsed < RECORD_MAX_SIZE && diskStoreFlush(store) != 0) {
+        return -1;
+    }
+
+    int length = encodeRecord(msg, store->writeBuffer + store->writeBufferUsed, store->writeBufferSize - store->writeBufferUsed);
+    if (length < 0) {
+        return -1;
+    }
+    if (store->writeBufferUsed == 0) {
+        store->firstBufferedMs = now;
+    }
+    int64_t offset = store->flushedLength + (int64_t)store->writeBufferUsed;
+    store->writeBufferUsed += (size_t)length;
+    diskIndexInsert(&store->index, msg->identifier, offset, length);
+    if (!inActive) {
+        bloomAdd(&store->bloom, msg->identifier);
+    }
+    if (store->bloom.count > store->bloom.capacity) {
+        // Past its capacity the false-positive rate climbs, so resize the filter
+        diskStoreRebuildBloom(store, store->bloom.falsePositiveRate);
+    }
+
+    if (store->writeBufferUsed >= store->writer.flushBytes) {
+        diskStoreFlush(store);
+    }
+    if (store->segmentMaxBytes > 0 && (size_t)store->flushedLength + store->writeBufferUsed >= store->segmentMaxBytes) {
+        diskStoreSeal(store);
+    }
+    return 1;
+}
+
+/**
+  * Order index records by identifier.
+  */
+static int compareIdentifier(const void *a, const void *b) {
+    int x = ((const IndexRecord*)a)->identifier;
+    int y = ((const IndexRecord*)b)->identifier;
+    return (x > y) - (x < y);
+}
+
+/**
+  * Seal the active segment: write its live records, sorted by identifier, to a new sealed segment
+  * with a sparse index, Bloom filter and id/time range, then start an empty active segment.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure (the active segment is left as it was).
+  */
+int diskStoreSeal(DiskStore *store) {
+    compactionAbort(store);
+    if (diskStoreFlush(store) != 0) {
+        return -1;
+    }
+    int count = 0;
+    IndexRecord *records = (IndexRecord*)malloc((store->index.count + 1) * sizeof(IndexRecord));
+    Segment *segments = (Segment*)realloc(store->segments, (store->segmentCount + 1) * sizeof(Segment));
+    if (records == NULL || segments == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed while sealing %s.\n", store->messagePath);
+        free(records);
+        if (segments != NULL) {
+            store->segments = segments;
+        }
+        return -1;
+    }
+    store->segments = segments;
+    for (int i = 0; i < store->index.capacity; i++) {
+        if (store->index.slots[i].length != 0) {
+            records[count++] = store->index.slots[i];
+        }
+    }
+    qsort(records, count, sizeof(IndexRecord), compareIdentifier);
+
+    char path[272];
+    snprintf(path, sizeof(path), "%s.%06d", store->messagePath, store->nextSequence);
+    SegmentWriter writer;
+    int source = open(store->messagePath, O_RDONLY);
+    if (source < 0 || segmentWriterOpen(&writer, path, count, store->falsePositiveRate, store->compressSegments) != 0) {
+        if (source >= 0) {
+            close(source);
+        }
+        free(records);
+        return -1;
+    }
+    unsigned char buffer[RECORD_MAX_SIZE];
+    int result = 0;
+    for (int i = 0; i < count && result == 0; i++) {
+        if (records[i].length > (int32_t)sizeof(buffer)
+            || pread(source, buffer, records[i].length, (off_t)records[i].offset) != records[i].length) {
+            fprintf(stderr, "Error: Unable to read message ID：%d while sealing.\n", records[i].identifier);
+            result = -1;
+        } else {
+            result = segmentWriterAdd(&writer, buffer, (uint32_t)records[i].length);
+        }
+    }
+    close(source);
+    free(records);
+    if (result != 0) {
+        segmentWriterAbort(&writer);
+        return -1;
+    }
+    if (segmentWriterFinish(&writer) != 0 || segmentOpen(&store->segments[store->segmentCount], path, store->nextSequence) != 0) {
+        return -1;
+    }
+    store->segmentCount++;
+    store->nextSequence++;
+
+    // Start an empty active segment. Its index is written first, with the id of the new file
+    char tmpPath[272];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", store->messagePath);
+    uint32_t fileId = generateFileId();
+    FILE *file = fopen(tmpPath, "wb");
+    bool ok = file != NULL && writeFileHeader(file, fileId) == 0 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (file != NULL) {
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && diskIndexWriteFile(store->indexPath, fileId, NULL, 0) == 0 && rename(tmpPath, store->messagePath) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error: Unable to start a new active segment %s, %s is dropped.\n", store->messagePath, path);
+        unlink(tmpPath);
+        // Every record of the sealed copy is still in the active segment, keeping both would duplicate them
+        store->segmentCount--;
+        store->nextSequence--;
+        segmentClose(&store->segments[store->segmentCount]);
+        unlink(path);
+        // The index file may already carry the id of the new file, reopening rebuilds it from the active segment
+        diskStoreReopenActive(store);
+        return -1;
+    }
+    printf("Sealed segment %s with %d messages\n", path, count);
+    return diskStoreReopenActive(store);
+}
+
+/**
+  * Move the sealed segments whose newest message was sent before `before` to an archive directory.
+  * They are no longer searched by this store.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  * - before: time_sent threshold (milliseconds).
+  * - archiveDir: string, existing directory that receives the segment files.
+  *
+  * return value:
+  * - int: Number of segments archived, or -1 if a segment could not be moved.
+  */
+int diskStoreArchiveSegments(DiskStore *store, int64_t before, const char *archiveDir) {
+    int archived = 0;
+    int kept = 0;
+    int result = 0;
+    for (int i = 0; i < store->segmentCount; i++) {
+        Segment *segment = &store->segments[i];
+        if (result == 0 && segment->footer.maxTime < before) {
+            const char *slash = strrchr(segment->path, '/');
+            char target[544];
+            snprintf(target, sizeof(target), "%s/%s", archiveDir, slash != NULL ? slash + 1 : segment->path);
+            if (rename(segment->path, target) == 0) {
+                segmentClose(segment);
+                archived++;
+                continue;
+            }
+            fprintf(stderr, "Error: Unable to move %s to %s.\n", segment->path, archiveDir);
+            result = -1;
+        }
+        store->segments[kept++] = *segment;
+    }
+    store->segmentCount = kept;
+    return result == 0 ? archived : -1;
+}
+
+/**
+  * Close the message store. Buffered records are flushed and, unless durability is DURABILITY_NONE, synced.
+  * A background compaction that has not finished yet is abandoned.
+  *
+  * Parameters:
+  * - store: Pointer to DiskStore structure.
+  */
+void diskStoreClose(DiskStore *store) {
+    compactionAbort(store);
+    activeClose(store);
+    for (int i = 0; i < store->segmentCount; i++) {
+        segmentClose(&store->segments[i]);
+    }
+    free(store->segments);
+    store->segments = NULL;
+    store->segmentCount = 0;
+}
@@ -0,0 +1,121 @@
+/*
+* disk_store.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_DISK_STORE_H
+#define P1_DISK_STORE_H
+#include <stdbool.h>
+#include "message.h"
+#include "disk_index.h"
+#include "bloom.h"
+#include "segment.h"
+
+//Define the message file and its persistent index file. The message file is the active segment;
+//full segments are sealed into "<message file>.<6-digit sequence>"
+#define MESSAGE_FILE "messages.dat"
+#define INDEX_FILE "messages.idx"
+//Text file of the earlier versions: one message per line, "identifier time_sent sender receiver content delivered".
+//It is no longer read, the import tool converts it into the message file
+#define LEGACY_FILE "messages.txt"
+#define SEGMENT_MAX_BYTES (4 * 1024 * 1024)
+//Seal segments in the block-compressed layout (see segment.h)
+#define DEFAULT_COMPRESS_SEGMENTS false
+
+//How disk hits are read: stdio reopens the file for every read, mmap serves them from a mapping of the file
+typedef enum DiskReadMode {
+    DISK_READ_STDIO = 0,
+    DISK_READ_MMAP = 1
+} DiskReadMode;
+
+#define DEFAULT_READ_MODE DISK_READ_MMAP
+#define MIN_MAP_LENGTH (1 << 20)
+#define BLOOM_FALSE_POSITIVE_RATE 0.01
+
+//When appended records are forced to stable storage
+typedef enum DurabilityMode {
+    DURABILITY_NONE = 0,     //never fsync, the OS writes the data back
+    DURABILITY_PERIODIC = 1, //fsync at most once every syncIntervalMs
+    DURABILITY_BATCH = 2     //fsync after every flushed batch
+} DurabilityMode;
+
+//Group-commit settings: appends are buffered and written in one batch
+typedef struct WriterConfig {
+    size_t flushBytes;           //flush once this many bytes are buffered
+    long long flushIntervalMs;   //flush once the oldest buffered record is this old
+    DurabilityMode durability;
+    long long syncIntervalMs;    //used by DURABILITY_PERIODIC
+} WriterConfig;
+
+#define DEFAULT_FLUSH_BYTES (64 * 1024)
+#define DEFAULT_FLUSH_INTERVAL_MS 100
+#define DEFAULT_DURABILITY DURABILITY_PERIODIC
+#define DEFAULT_SYNC_INTERVAL_MS 1000
+
+//Background compaction starts once this share of the records in the message file is dead (0 disables it)
+#define COMPACT_DEAD_RATIO 0.5
+#define COMPACT_MIN_RECORDS 1024
+
+struct CompactionJob;
+
+//Location of the bytes of a message on disk, see diskStoreLocate
+typedef struct DiskSpan {
+    int fd;
+    int64_t offset;
+    int32_t length;
+    bool compressed;    //the span is a block of a compressed segment
+} DiskSpan;
+
+#define DISK_NOT_FOUND 0
+#define DISK_LOCATED 1
+#define DISK_IN_MEMORY 2
+
+typedef struct DiskStore {
+    char messagePath[256];
+    char indexPath[256];
+    //Settings, kept when the active segment is reopened
+    DiskReadMode readMode;
+    WriterConfig writer;
+    double falsePositiveRate;
+    double compactDeadRatio;
+    size_t segmentMaxBytes;    //seal the active segment once it reaches this size, 0 never seals
+    bool compressSegments;     //seal segments in the block-compressed layout
+    //Sealed segments, oldest first
+    Segment *segments;
+    int segmentCount;
+    int nextSequence;
+    //Active segment
+    DiskIndex index;
+    BloomFilter bloom;         //identifiers in the active segment, answers most "not there" questions without the index
+    int readFd;                //descriptor the mapping is created from, -1 if not open
+    unsigned char *map;        //mapping of the message file, NULL if none
+    size_t mapLength;          //bytes reserved by the mapping, may run past the end of the file
+    size_t mappedFileLength;   //file length when last checked, only bytes below it are read
+    int writeFd;               //kept open for appending, -1 if not open
+    unsigned char *writeBuffer; //records appended since the last flush
+    size_t writeBufferSize;
+    size_t writeBufferUsed;
+    int64_t flushedLength;     //bytes of the message file already written, buffered records start here
+    long long firstBufferedMs; //when the oldest buffered record was appended
+    long long lastSyncMs;
+    bool syncPending;          //data written since the last fsync
+    struct CompactionJob *compaction; //background compaction in progress, NULL if none
+} DiskStore;
+
+int diskStoreOpen(DiskStore *store, const char *messagePath, const char *indexPath);
+void diskStoreSetReadMode(DiskStore *store, DiskReadMode mode);
+int diskStoreSetFalsePositiveRate(DiskStore *store, double falsePositiveRate);
+int diskStoreSetWriterConfig(DiskStore *store, const WriterConfig *config);
+int diskStoreFlush(DiskStore *store);
+int diskStoreReopenActive(DiskStore *store);
+int diskStoreSeal(DiskStore *store);
+int diskStoreArchiveSegments(DiskStore *store, int64_t before, const char *archiveDir);
+bool diskStoreContains(DiskStore *store, int identifier);
+int diskStoreLocate(DiskStore *store, int identifier, DiskSpan *span);
+int diskStoreRead(DiskStore *store, int identifier, Message *msg);
+int diskStoreAppend(DiskStore *store, const Message *msg);
+void diskStoreClose(DiskStore *store);
+#endif //P1_DISK_STORE_H
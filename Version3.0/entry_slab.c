@@ -0,0 +1,116 @@
+/*
+* entry_slab.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "entry_slab.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/**
+  * Map the storage of a slab. The pages are only touched once slots are handed out,
+  * so a large cache that stays mostly empty does not cost its full size in memory.
+  *
+  * Parameters:
+  * - slab: Pointer to EntrySlab structure to initialize.
+  * - capacity: integer, number of entries the slab holds.
+  * - hugePages: bool, ask the kernel to back the slab with transparent huge pages.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the memory could not be mapped.
+  */
+int slabInit(EntrySlab *slab, int capacity, bool hugePages) {
+    // Both arrays share one mapping, the payloads start on a cache line after the entries
+    size_t entryBytes = ((size_t)capacity * sizeof(CacheHashEntry) + 63) / 64 * 64;
+    size_t bytes = entryBytes + (size_t)capacity * sizeof(CachePayload);
+    // A huge page can only back a 2 MB-aligned range, so a huge-page slab maps one page more than it needs,
+    // starts on the first aligned address and gives the slack on both sides back
+    size_t slack = 0;
+    if (hugePages) {
+        bytes = (bytes + SLAB_HUGE_PAGE_SIZE - 1) / SLAB_HUGE_PAGE_SIZE * SLAB_HUGE_PAGE_SIZE;
+        slack = SLAB_HUGE_PAGE_SIZE;
+    }
+    char *mapping = mmap(NULL, bytes + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Memory allocation failed for EntrySlab.\n");
+        return -1;
+    }
+    char *memory = mapping;
+    if (slack > 0) {
+        memory = (char*)(((uintptr_t)mapping + SLAB_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_HUGE_PAGE_SIZE - 1));
+        if (memory > mapping) {
+            munmap(mapping, (size_t)(memory - mapping));
+        }
+        if (memory + bytes < mapping + bytes + slack) {
+            munmap(memory + bytes, (size_t)(mapping + bytes + slack - (memory + bytes)));
+        }
+    }
+#ifdef MADV_HUGEPAGE
+    // Only a hint: without THP support (or with THP disabled) the slab keeps normal pages
+    if (hugePages) {
+        madvise(memory, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    slab->slots = (CacheHashEntry*)memory;
+    slab->payloads = (CachePayload*)(memory + entryBytes);
+    slab->bytes = bytes;
+    slab->capacity = capacity;
+    slab->nextUnused = 0;
+    slab->freeList = NULL;
+    return 0;
+}
+
+/**
+  * Take a slot for a new entry: the most recently released one, or else the next slot never used.
+  *
+  * Parameters:
+  * - slab: Pointer to EntrySlab structure.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to an uninitialized entry, or NULL if all slots are in use.
+  */
+CacheHashEntry* slabAlloc(EntrySlab *slab) {
+    CacheHashEntry *entry = slab->freeList;
+    if (entry != NULL) {
+        slab->freeList = entry->next;
+        return entry;
+    }
+    if (slab->nextUnused < slab->capacity) {
+        return &slab->slots[slab->nextUnused++];
+    }
+    return NULL;
+}
+
+/**
+  * Give the slot of an entry back to the slab.
+  *
+  * Parameters:
+  * - slab: Pointer to EntrySlab structure.
+  * - entry: Pointer to an entry returned by slabAlloc, no longer in the cache.
+  */
+void slabFree(EntrySlab *slab, CacheHashEntry *entry) {
+    entry->next = slab->freeList;
+    slab->freeList = entry;
+}
+
+/**
+  * Unmap the slab, which releases all entries at once.
+  *
+  * Parameters:
+  * - slab: Pointer to EntrySlab structure.
+  */
+void slabDestroy(EntrySlab *slab) {
+    if (slab->slots != NULL) {
+        munmap(slab->slots, slab->bytes);
+    }
+    slab->slots = NULL;
+    slab->payloads = NULL;
+    slab->bytes = 0;
+    slab->capacity = 0;
+    slab->nextUnused = 0;
+    slab->freeList = NULL;
+}
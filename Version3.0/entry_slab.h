@@ -0,0 +1,23 @@
+/*
+* entry_slab.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_ENTRY_SLAB_H
+#define P1_ENTRY_SLAB_H
+#include "message.h"
+
+//Huge pages are 2 MB on x86-64 and most arm64 kernels, a huge-page slab is aligned to and rounded up to a multiple of it
+#define SLAB_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+//The payload stored in the same slot as an entry of the slab
+#define SLAB_PAYLOAD(slab, entry) (&(slab)->payloads[(entry) - (slab)->slots])
+
+int slabInit(EntrySlab *slab, int capacity, bool hugePages);
+CacheHashEntry* slabAlloc(EntrySlab *slab);
+void slabFree(EntrySlab *slab, CacheHashEntry *entry);
+void slabDestroy(EntrySlab *slab);
+#endif //P1_ENTRY_SLAB_H
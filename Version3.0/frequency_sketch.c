@@ -0,0 +1,152 @@
+/*
+* frequency_sketch.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "frequency_sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+  * Mix a key into a 64-bit hash (splitmix64 finalizer). Each row of the sketch uses 16 bits of it.
+  */
+static uint64_t sketchHash(int key) {
+    uint64_t x = (uint64_t)(uint32_t)key + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+//Index of the counter of a key in a row; two 4-bit counters share a byte, the even one in the low bits
+static inline int counterIndex(const FrequencySketch *sketch, uint64_t hash, int row) {
+    return row * sketch->width + (int)((hash >> (row * 16)) & (uint64_t)(sketch->width - 1));
+}
+
+static inline int counterValue(const FrequencySketch *sketch, int index) {
+    return (sketch->counters[index >> 1] >> ((index & 1) * 4)) & SKETCH_MAX_COUNT;
+}
+
+//Bits of a key in the doorkeeper, taken from the hash bits the rows do not use up
+static inline uint32_t doorkeeperBit(const FrequencySketch *sketch, uint64_t hash, int i) {
+    uint64_t mixed = hash * 0xD6E8FEB86659FD93ull;
+    return (uint32_t)(mixed >> (i * 32)) & (uint32_t)(sketch->doorkeeperBits - 1);
+}
+
+static bool doorkeeperContains(const FrequencySketch *sketch, uint64_t hash) {
+    for (int i = 0; i < 2; i++) {
+        uint32_t bit = doorkeeperBit(sketch, hash, i);
+        if ((sketch->doorkeeper[bit >> 6] & (1ull << (bit & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * Size a sketch for a cache: one counter per cached message and row (rounded up to a power of two,
+  * between SKETCH_MIN_WIDTH and SKETCH_MAX_WIDTH), and twice as many doorkeeper bits.
+  *
+  * Parameters:
+  * - sketch: Pointer to FrequencySketch structure to initialize.
+  * - capacity: integer, capacity of the cache the sketch admits messages to.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+int sketchInit(FrequencySketch *sketch, int capacity) {
+    int width = SKETCH_MIN_WIDTH;
+    while (width < capacity && width < SKETCH_MAX_WIDTH) {
+        width *= 2;
+    }
+    sketch->width = width;
+    sketch->doorkeeperBits = width * 2;
+    sketch->counters = (unsigned char*)calloc((size_t)SKETCH_DEPTH * width / 2, 1);
+    sketch->doorkeeper = (uint64_t*)calloc(sketch->doorkeeperBits / 64, sizeof(uint64_t));
+    if (sketch->counters == NULL || sketch->doorkeeper == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for FrequencySketch.\n");
+        sketchFree(sketch);
+        return -1;
+    }
+    sketch->additions = 0;
+    sketch->sampleSize = width * SKETCH_SAMPLE_FACTOR;
+    return 0;
+}
+
+/**
+  * Halve every counter and clear the doorkeeper, so the sketch follows the recent accesses
+  * and formerly popular messages lose their weight.
+  */
+static void sketchAge(FrequencySketch *sketch) {
+    for (int i = 0; i < SKETCH_DEPTH * sketch->width / 2; i++) {
+        sketch->counters[i] = (unsigned char)((sketch->counters[i] >> 1) & 0x77);
+    }
+    memset(sketch->doorkeeper, 0, (size_t)sketch->doorkeeperBits / 8);
+    sketch->additions /= 2;
+}
+
+/**
+  * Count an access of a key. The first one only sets its bits in the doorkeeper, the later ones raise
+  * its counter in every row (saturating at SKETCH_MAX_COUNT). Every sampleSize accesses the sketch ages.
+  *
+  * Parameters:
+  * - sketch: Pointer to FrequencySketch structure.
+  * - key: integer, message identifier.
+  */
+void sketchRecord(FrequencySketch *sketch, int key) {
+    uint64_t hash = sketchHash(key);
+    if (!doorkeeperContains(sketch, hash)) {
+        for (int i = 0; i < 2; i++) {
+            uint32_t bit = doorkeeperBit(sketch, hash, i);
+            sketch->doorkeeper[bit >> 6] |= 1ull << (bit & 63);
+        }
+    } else {
+        for (int row = 0; row < SKETCH_DEPTH; row++) {
+            int index = counterIndex(sketch, hash, row);
+            if (counterValue(sketch, index) < SKETCH_MAX_COUNT) {
+                sketch->counters[index >> 1] += (unsigned char)(1 << ((index & 1) * 4));
+            }
+        }
+    }
+    if (++sketch->additions >= sketch->sampleSize) {
+        sketchAge(sketch);
+    }
+}
+
+/**
+  * Estimated number of recent accesses of a key: the smallest of its counters, plus one if it is in the doorkeeper.
+  *
+  * Parameters:
+  * - sketch: Pointer to FrequencySketch structure.
+  * - key: integer, message identifier.
+  *
+  * return value:
+  * - int: Estimate between 0 and SKETCH_MAX_COUNT + 1.
+  */
+int sketchEstimate(const FrequencySketch *sketch, int key) {
+    uint64_t hash = sketchHash(key);
+    int estimate = SKETCH_MAX_COUNT;
+    for (int row = 0; row < SKETCH_DEPTH; row++) {
+        int value = counterValue(sketch, counterIndex(sketch, hash, row));
+        if (value < estimate) {
+            estimate = value;
+        }
+    }
+    return estimate + (doorkeeperContains(sketch, hash) ? 1 : 0);
+}
+
+/**
+  * Free the arrays of a sketch.
+  *
+  * Parameters:
+  * - sketch: Pointer to FrequencySketch structure.
+  */
+void sketchFree(FrequencySketch *sketch) {
+    free(sketch->counters);
+    free(sketch->doorkeeper);
+    sketch->counters = NULL;
+    sketch->doorkeeper = NULL;
+}
@@ -0,0 +1,17 @@
+/*
+* frequency_sketch.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_FREQUENCY_SKETCH_H
+#define P1_FREQUENCY_SKETCH_H
+#include "message.h"
+
+int sketchInit(FrequencySketch *sketch, int capacity);
+void sketchRecord(FrequencySketch *sketch, int key);
+int sketchEstimate(const FrequencySketch *sketch, int key);
+void sketchFree(FrequencySketch *sketch);
+#endif //P1_FREQUENCY_SKETCH_H
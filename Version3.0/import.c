@@ -0,0 +1,117 @@
+/*
+* import.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "disk_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Longest line of the legacy text file (LEGACY_FILE in disk_store.h)
+#define LEGACY_LINE_LIMIT 2048
+
+//Write settings for the import: large batches, no fsync until the store is closed
+#define IMPORT_FLUSH_BYTES (4 * 1024 * 1024)
+
+/**
+  * Parse one line of the legacy text format.
+  *
+  * Parameters:
+  * - line: string, one line of the text file.
+  * - msg: Pointer to the Message structure that receives the fields.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the line is not a message.
+  */
+static int parseLegacyLine(const char *line, Message *msg) {
+    long long timeSent;
+    memset(msg, 0, sizeof(Message));
+    if (sscanf(line, "%d %lld %99s %99s %799s %d", &msg->identifier, &timeSent,
+               msg->sender, msg->receiver, msg->content, &msg->delivered) != 6) {
+        return -1;
+    }
+    msg->time_sent = (time_t)timeSent;
+    return 0;
+}
+
+/**
+  * Import a legacy messages.txt into the binary message store in one pass.
+  * Each line is parsed and appended through the store, whose in-memory index and Bloom filters drop
+  * identifiers that are already on disk (the first line of an identifier wins). Appends are batched,
+  * the index is built as the records are written, and full segments are sealed on the way.
+  *
+  * Usage: import [text file] [message file] [index file]
+  */
+int main(int argc, char *argv[]) {
+    const char *textPath = argc > 1 ? argv[1] : LEGACY_FILE;
+    const char *messagePath = argc > 2 ? argv[2] : MESSAGE_FILE;
+    const char *indexPath = argc > 3 ? argv[3] : INDEX_FILE;
+
+    FILE *text = fopen(textPath, "r");
+    if (text == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", textPath);
+        return 1;
+    }
+    DiskStore store;
+    if (diskStoreOpen(&store, messagePath, indexPath) != 0) {
+        fclose(text);
+        return 1;
+    }
+    WriterConfig writer = { IMPORT_FLUSH_BYTES, 60 * 1000, DURABILITY_NONE, 0 };
+    if (diskStoreSetWriterConfig(&store, &writer) != 0) {
+        diskStoreClose(&store);
+        fclose(text);
+        return 1;
+    }
+    // Nothing is dead in a fresh import, do not let a background compaction start halfway
+    store.compactDeadRatio = 0;
+
+    long long start = current_timestamp_ms();
+    long imported = 0, duplicates = 0, malformed = 0, lineNumber = 0;
+    char line[LEGACY_LINE_LIMIT];
+    Message msg;
+    int result = 0;
+    while (fgets(line, sizeof(line), text) != NULL) {
+        lineNumber++;
+        if (line[0] == '\n' || line[0] == '\0') {
+            continue;
+        }
+        if (parseLegacyLine(line, &msg) != 0) {
+            fprintf(stderr, "Warning: skipping line %ld of %s.\n", lineNumber, textPath);
+            malformed++;
+            continue;
+        }
+        // The first line of an identifier wins, a later one would replace it in the store
+        if (diskStoreContains(&store, msg.identifier)) {
+            duplicates++;
+            continue;
+        }
+        int appended = diskStoreAppend(&store, &msg);
+        if (appended == 1) {
+            imported++;
+        } else if (appended == 0) {
+            duplicates++;
+        } else {
+            fprintf(stderr, "Error: Unable to write message ID：%d to %s.\n", msg.identifier, messagePath);
+            result = 1;
+            break;
+        }
+    }
+    fclose(text);
+
+    // Make the import durable before reporting it
+    writer.durability = DURABILITY_BATCH;
+    if (diskStoreSetWriterConfig(&store, &writer) != 0 || diskStoreFlush(&store) != 0) {
+        result = 1;
+    }
+    int segments = store.segmentCount;
+    diskStoreClose(&store);
+
+    printf("Imported %ld messages from %s (%ld duplicates dropped, %ld lines skipped) in %.2f s, %d sealed segments\n",
+           imported, textPath, duplicates, malformed, (current_timestamp_ms() - start) / 1000.0, segments);
+    return result;
+}
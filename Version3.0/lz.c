@@ -0,0 +1,189 @@
+/*
+* lz.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+
+//Size of the match finder table: positions are hashed by their first LZ_MIN_MATCH bytes
+#define LZ_HASH_BITS 12
+
+static uint32_t lzHash(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+  * Write the continuation bytes of a length whose nibble is 15.
+  */
+static unsigned char* lzWriteLength(unsigned char *out, int remainder) {
+    while (remainder >= 255) {
+        *out++ = 255;
+        remainder -= 255;
+    }
+    *out++ = (unsigned char)remainder;
+    return out;
+}
+
+/**
+  * Write one sequence: literals followed by a match, or only literals if matchLength is 0.
+  *
+  * return value:
+  * - unsigned char*: End of the written sequence, or NULL if it does not fit before end.
+  */
+static unsigned char* lzWriteSequence(unsigned char *out, const unsigned char *end, const unsigned char *literals,
+                                      int literalLength, int matchLength, int offset) {
+    if (end - out < 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1) {
+        return NULL;
+    }
+    int matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    *out++ = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    if (literalLength >= 15) {
+        out = lzWriteLength(out, literalLength - 15);
+    }
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+    if (matchLength > 0) {
+        *out++ = (unsigned char)(offset & 0xff);
+        *out++ = (unsigned char)(offset >> 8);
+        if (matchCode >= 15) {
+            out = lzWriteLength(out, matchCode - 15);
+        }
+    }
+    return out;
+}
+
+/**
+  * Compress a block.
+  *
+  * Parameters:
+  * - source: bytes to compress.
+  * - sourceLength: number of bytes in source.
+  * - target: output buffer.
+  * - targetCapacity: size of the output buffer, LZ_BOUND(sourceLength) is always enough.
+  *
+  * return value:
+  * - int: Compressed length in bytes, or -1 if the output buffer is too small.
+  */
+int lzCompress(const unsigned char *source, int sourceLength, unsigned char *target, int targetCapacity) {
+    int table[1 << LZ_HASH_BITS];
+    memset(table, 0xff, sizeof(table));
+    unsigned char *out = target;
+    const unsigned char *end = target + targetCapacity;
+    int anchor = 0;
+    int position = 0;
+
+    while (position + LZ_MIN_MATCH <= sourceLength) {
+        uint32_t hash = lzHash(source + position);
+        int candidate = table[hash];
+        table[hash] = position;
+        if (candidate < 0 || position - candidate > LZ_MAX_OFFSET
+            || memcmp(source + candidate, source + position, LZ_MIN_MATCH) != 0) {
+            position++;
+            continue;
+        }
+        int length = LZ_MIN_MATCH;
+        while (position + length < sourceLength && source[candidate + length] == source[position + length]) {
+            length++;
+        }
+        out = lzWriteSequence(out, end, source + anchor, position - anchor, length, position - candidate);
+        if (out == NULL) {
+            return -1;
+        }
+        position += length;
+        anchor = position;
+    }
+
+    out = lzWriteSequence(out, end, source + anchor, sourceLength - anchor, 0, 0);
+    return out == NULL ? -1 : (int)(out - target);
+}
+
+/**
+  * Read the continuation bytes of a length whose nibble is 15.
+  *
+  * return value:
+  * - int: The continuation, or -1 if the input ends first.
+  */
+static int lzReadLength(const unsigned char **in, const unsigned char *end) {
+    int length = 0;
+    unsigned char byte;
+    do {
+        if (*in >= end) {
+            return -1;
+        }
+        byte = *(*in)++;
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+/**
+  * Decompress a block written by lzCompress.
+  *
+  * Parameters:
+  * - source: compressed bytes.
+  * - sourceLength: number of bytes in source.
+  * - target: output buffer.
+  * - targetCapacity: size of the output buffer.
+  *
+  * return value:
+  * - int: Decompressed length in bytes, or -1 if the input is corrupt or does not fit.
+  */
+int lzDecompress(const unsigned char *source, int sourceLength, unsigned char *target, int targetCapacity) {
+    const unsigned char *in = source;
+    const unsigned char *inEnd = source + sourceLength;
+    unsigned char *out = target;
+    const unsigned char *outEnd = target + targetCapacity;
+
+    while (in < inEnd) {
+        unsigned char token = *in++;
+        int literalLength = token >> 4;
+        if (literalLength == 15) {
+            int more = lzReadLength(&in, inEnd);
+            if (more < 0) {
+                return -1;
+            }
+            literalLength += more;
+        }
+        if (inEnd - in < literalLength || outEnd - out < literalLength) {
+            return -1;
+        }
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == inEnd) {
+            break;  //last literals of the block
+        }
+
+        if (inEnd - in < 2) {
+            return -1;
+        }
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        int matchLength = token & 15;
+        if (matchLength == 15) {
+            int more = lzReadLength(&in, inEnd);
+            if (more < 0) {
+                return -1;
+            }
+            matchLength += more;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out - target || outEnd - out < matchLength) {
+            return -1;
+        }
+        // Byte by byte: the match may overlap the bytes it produces
+        const unsigned char *match = out - offset;
+        for (int i = 0; i < matchLength; i++) {
+            out[i] = match[i];
+        }
+        out += matchLength;
+    }
+    return (int)(out - target);
+}
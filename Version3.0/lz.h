@@ -0,0 +1,27 @@
+/*
+* lz.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_LZ_H
+#define P1_LZ_H
+
+/*
+ * A small LZ77 compressor for blocks of records (LZ4-like sequence format):
+ *   token byte: high 4 bits literal count, low 4 bits match length - LZ_MIN_MATCH
+ *   (a nibble of 15 is continued by bytes of 255 and a final byte < 255)
+ *   literals
+ *   uint16 match offset (little endian), omitted after the last literals of the block
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+//Worst-case compressed size of n input bytes
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+int lzCompress(const unsigned char *source, int sourceLength, unsigned char *target, int targetCapacity);
+int lzDecompress(const unsigned char *source, int sourceLength, unsigned char *target, int targetCapacity);
+#endif //P1_LZ_H
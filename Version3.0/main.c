@@ -12,32 +12,68 @@
 #include <string.h>
 #include <unistd.h>
 
-int cacheCount = 0;
-CacheHashEntry* cacheHashTable[CACHE_SIZE];
-LRUCache lruCache = {NULL, NULL};
+//Names of the replacement strategies, indexed by CacheConfig.repStrategy
+static const char *STRATEGY_NAMES[] = { "LRU", "Random", "CLOCK", "LFU", "ARC", "SLRU", "LIRS" };
+#define STRATEGY_COUNT (int)(sizeof(STRATEGY_NAMES) / sizeof(STRATEGY_NAMES[0]))
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 2) {
+    if (argc < 2 || argc > 5) {
         printf("Please enter an argument.\n");
         return -1;
     }
 
+    // Offline compaction of the message store
+    if (strcmp(argv[1], "compact") == 0) {
+        return compactMessageStore() == 0 ? 0 : -1;
+    }
+
     int repStrategy=-1;
-    if(strcmp(argv[1], "0") == 0){
-        repStrategy=0;
-        printf("-----------------------------------------------Use LRU strategy-----------------------------------------------\n");
-    }else if(strcmp(argv[1], "1") == 0){
-        repStrategy=1;
-        printf("-----------------------------------------------Use Random strategy-----------------------------------------------\n");
-    }else{
-        printf("The input argument is illegal, please enter 0 (representing LRU) or 1 (representing Random)");
+    for (int i = 0; i < STRATEGY_COUNT; i++) {
+        char number[12];
+        snprintf(number, sizeof(number), "%d", i);
+        if (strcmp(argv[1], number) == 0) {
+            repStrategy = i;
+        }
+    }
+    if(repStrategy < 0){
+        printf("The input argument is illegal, please enter 0 (representing LRU), 1 (representing Random), 2 (representing CLOCK), 3 (representing LFU), 4 (representing ARC), 5 (representing SLRU) or 6 (representing LIRS)");
         return -1;
     }
-
-    // Initialize the hash table
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        cacheHashTable[i] = NULL;
+    printf("-----------------------------------------------Use %s strategy-----------------------------------------------\n", STRATEGY_NAMES[repStrategy]);
+
+    // Create the cache, the optional second argument is its capacity (default CACHE_SIZE)
+    // and the optional third one its index ("chained", the default, or "swiss"),
+    // the optional fourth one its admission ("all", the default, or "tinylfu")
+    CacheConfig config = { .capacity = CACHE_SIZE, .initialBuckets = 0, .repStrategy = repStrategy,
+                           .indexType = CACHE_INDEX_CHAINED };
+    if (argc >= 3) {
+        config.capacity = atoi(argv[2]);
+        if (config.capacity <= 0) {
+            printf("The cache capacity is illegal, please enter a positive integer");
+            return -1;
+        }
+        config.initialBuckets = config.capacity;
+    }
+    if (argc >= 4) {
+        if (strcmp(argv[3], "swiss") == 0) {
+            config.indexType = CACHE_INDEX_SWISS;
+        } else if (strcmp(argv[3], "chained") != 0) {
+            printf("The cache index is illegal, please enter chained or swiss");
+            return -1;
+        }
+    }
+    if (argc == 5) {
+        if (strcmp(argv[4], "tinylfu") == 0) {
+            config.admission = true;
+        } else if (strcmp(argv[4], "all") != 0) {
+            printf("The cache admission is illegal, please enter all or tinylfu");
+            return -1;
+        }
+    }
+    Cache *cache = createCache(&config);
+    if (cache == NULL) {
+        return -1;
     }
 
 
@@ -50,7 +86,7 @@ int main(int argc, char *argv[]) {
 
         if (msg != NULL) {
             printf("New message ID:%d, Time：%ld, Content：%s\n", msg->identifier , msg->time_sent, msg->content);
-            store_msg(msg, cacheHashTable, CACHE_SIZE, &lruCache, &cacheCount, repStrategy);
+            store_msg(msg, cache);
             free(msg);
         }
         free(content);
@@ -59,7 +95,7 @@ int main(int argc, char *argv[]) {
     // Test code----retrieve and print 20 messages created before
     printf("---------------------------------------Retrieve 20 created messages---------------------------------------\n");
     for (int i = 0; i < 20; i++) {
-        MessageWithStatus* r = retrieve_msg(i, cacheHashTable, CACHE_SIZE, &lruCache, &cacheCount, repStrategy);
+        MessageWithStatus* r = retrieve_msg(i, cache);
         if (r != NULL && r->hitStatus != 3) {
             printf("Retrieved Message %d: ", i);
             printf("Unique ID: %d Sender: %s Receiver: %s Content: %s\n",
@@ -82,7 +118,7 @@ int main(int argc, char *argv[]) {
         usleep(1000);
         printf("access message ID：%d \n", test_set[i]);
 
-        MessageWithStatus* msgWithStatus = retrieve_msg(test_set[i], cacheHashTable, CACHE_SIZE, &lruCache, &cacheCount, repStrategy);
+        MessageWithStatus* msgWithStatus = retrieve_msg(test_set[i], cache);
         if (msgWithStatus != NULL && msgWithStatus->hitStatus == 1) {
             hits++;
         } else {
@@ -90,25 +126,13 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if(repStrategy==0){
-        printf("LRU Hits: %d\n", hits);
-        printf("LRU Misses: %d\n", misses);
-        printf("LRU Hit Rate: %.2f%%\n", (double)hits / (hits + misses) * 100);
-    } else if(repStrategy==1){
-        printf("Random Hits: %d\n", hits);
-        printf("Random Misses: %d\n", misses);
-        printf("Random Hit Rate: %.2f%%\n", (double)hits / (hits + misses) * 100);
-    }
+    printf("%s Hits: %d\n", STRATEGY_NAMES[repStrategy], hits);
+    printf("%s Misses: %d\n", STRATEGY_NAMES[repStrategy], misses);
+    printf("%s Hit Rate: %.2f%%\n", STRATEGY_NAMES[repStrategy], (double)hits / (hits + misses) * 100);
 
     // Free memory in cache and hash table
-    for (int i = 0; i < CACHE_SIZE; i++) {
-        CacheHashEntry *currentEntry = cacheHashTable[i];
-        while (currentEntry != NULL) {
-            CacheHashEntry *nextEntry = currentEntry->next;
-            free(currentEntry);
-            currentEntry = nextEntry;
-        }
-    }
+    destroyCache(cache);
+    closeMessageStore();
 
     return 0;
 }
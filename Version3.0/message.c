@@ -7,192 +7,1323 @@
 */
 
 #include "message.h"
+#include "disk_store.h"
+#include "compaction.h"
+#include "async_io.h"
+#include "cache_table.h"
+#include "swiss_table.h"
+#include "entry_slab.h"
+#include "frequency_sketch.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <time.h>
 #include <stdio.h>
 #include <limits.h>
 
-extern int cacheCount;
-extern LRUCache lruCache;
+//Binary message file and its persistent index, opened on first use
+static DiskStore diskStore;
+static bool diskStoreReady = false;
+static bool diskStoreExitHandler = false;
+
+//A disk read of retrieve_msg_async that is in flight, with the cache the message is loaded into
+typedef struct PendingRetrieve {
+    bool used;
+    int identifier;
+    DiskSpan span;
+    unsigned char *buffer;
+    RetrieveCallback callback;
+    void *context;
+    Cache *cache;
+} PendingRetrieve;
+
+static AsyncIo asyncIo;
+static bool asyncIoReady = false;
+static PendingRetrieve pendingRetrieves[ASYNC_QUEUE_DEPTH];
+
+/**
+  * Get the message store on disk, opening it the first time it is needed.
+  *
+  * return value:
+  * - DiskStore*: Pointer to the store. If it could not be opened, NULL is returned.
+  */
+static DiskStore* messageStore() {
+    if (!diskStoreReady) {
+        if (diskStoreOpen(&diskStore, MESSAGE_FILE, INDEX_FILE) != 0) {
+            return NULL;
+        }
+        diskStoreReady = true;
+        // Messages of an earlier version are only reachable once they are imported
+        if (diskStore.index.count == 0 && diskStore.segmentCount == 0 && access(LEGACY_FILE, F_OK) == 0) {
+            fprintf(stderr, "Notice: %s is not read any more, run \"make import\" (P1_import) to move its messages into %s.\n",
+                    LEGACY_FILE, MESSAGE_FILE);
+        }
+        // Appends are buffered, make sure they reach the file even if the caller never closes the store
+        if (!diskStoreExitHandler) {
+            atexit(closeMessageStore);
+            diskStoreExitHandler = true;
+        }
+    }
+    return &diskStore;
+}
+
+/**
+  * Close the message store on disk, after completing the asynchronous retrieves in flight.
+  * It is opened again on the next disk access.
+  */
+void closeMessageStore() {
+    if (asyncIoReady) {
+        while (asyncIo.inFlight > 0 && poll_retrieve(1) > 0) {
+        }
+        asyncIoClose(&asyncIo);
+        asyncIoReady = false;
+    }
+    if (diskStoreReady) {
+        diskStoreClose(&diskStore);
+        diskStoreReady = false;
+    }
+}
+
+/**
+  * Finish the asynchronous retrieves that load into a cache before it is destroyed; their callbacks still see it.
+  * If waiting for the disk fails, the reads left are detached from the cache and answered without it.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure about to be destroyed.
+  */
+static void drainRetrieves(Cache *cache) {
+    for (int i = 0; i < ASYNC_QUEUE_DEPTH; i++) {
+        while (pendingRetrieves[i].used && pendingRetrieves[i].cache == cache) {
+            if (poll_retrieve(1) <= 0) {
+                pendingRetrieves[i].cache = NULL;
+            }
+        }
+    }
+}
+
+/**
+  * Compact the message store on disk in the calling thread, keeping one record per identifier.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure.
+  */
+int compactMessageStore() {
+    DiskStore *store = messageStore();
+    if (store == NULL) {
+        fprintf(stderr, "Error: Unable to open the message store.\n");
+        return -1;
+    }
+    printf("Dead records: %d of %d\n", store->index.recordCount - store->index.count, store->index.recordCount);
+    return diskStoreCompact(store);
+}
+
+/**
+  * Index operations, dispatched on the index type chosen in the cache configuration.
+  */
+static CacheHashEntry* indexFind(Cache *cache, int key) {
+    if (cache->config.indexType == CACHE_INDEX_SWISS) {
+        return swissFind(&cache->swiss, key);
+    }
+    return cacheTableFind(&cache->table, key);
+}
+
+static int indexInsert(Cache *cache, CacheHashEntry *entry) {
+    if (cache->config.indexType == CACHE_INDEX_SWISS) {
+        return swissInsert(&cache->swiss, entry);
+    }
+    cacheTableInsert(&cache->table, entry);
+    return 0;
+}
+
+static void indexUnlink(Cache *cache, CacheHashEntry *entry) {
+    if (cache->config.indexType == CACHE_INDEX_SWISS) {
+        swissRemove(&cache->swiss, entry->key);
+    } else {
+        cacheTableUnlink(&cache->table, entry);
+    }
+}
+
+/**
+  * Text of a cached message: inline in its payload if it fits, else the heap block.
+  */
+static char* payloadText(CachePayload *payload) {
+    size_t size = payload->senderLength + payload->receiverLength + payload->contentLength + 3;
+    return size <= CACHE_INLINE_PAYLOAD ? payload->text : payload->heapText;
+}
+
+/**
+  * Pack a message into the payload of a cache slot: the fixed fields, then the text inline if it fits,
+  * else in one heap block.
+  *
+  * Parameters:
+  * - payload: Pointer to the CachePayload that receives the message.
+  * - msg: Pointer to the Message structure to pack.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+static int packPayload(CachePayload *payload, const Message *msg) {
+    size_t senderLength = strnlen(msg->sender, sizeof(msg->sender) - 1);
+    size_t receiverLength = strnlen(msg->receiver, sizeof(msg->receiver) - 1);
+    size_t contentLength = strnlen(msg->content, sizeof(msg->content) - 1);
+    size_t size = senderLength + receiverLength + contentLength + 3;
+    char *text = payload->text;
+    if (size > CACHE_INLINE_PAYLOAD) {
+        text = (char*)malloc(size);
+        if (text == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the payload of message ID：%d.\n", msg->identifier);
+            return -1;
+        }
+        payload->heapText = text;
+    }
+    payload->time_sent = msg->time_sent;
+    payload->delivered = msg->delivered;
+    payload->senderLength = (unsigned short)senderLength;
+    payload->receiverLength = (unsigned short)receiverLength;
+    payload->contentLength = (unsigned short)contentLength;
+    memcpy(text, msg->sender, senderLength);
+    text[senderLength] = '\0';
+    text += senderLength + 1;
+    memcpy(text, msg->receiver, receiverLength);
+    text[receiverLength] = '\0';
+    text += receiverLength + 1;
+    memcpy(text, msg->content, contentLength);
+    text[contentLength] = '\0';
+    return 0;
+}
+
+/**
+  * Rebuild the full message of a cache entry from its payload.
+  *
+  * Parameters:
+  * - key: integer, identifier of the message.
+  * - payload: Pointer to the CachePayload of the entry.
+  * - msg: Pointer to the Message structure that receives the message.
+  */
+static void unpackPayload(int key, CachePayload *payload, Message *msg) {
+    msg->identifier = key;
+    msg->time_sent = payload->time_sent;
+    msg->delivered = payload->delivered;
+    const char *text = payloadText(payload);
+    memcpy(msg->sender, text, payload->senderLength + 1);
+    text += payload->senderLength + 1;
+    memcpy(msg->receiver, text, payload->receiverLength + 1);
+    text += payload->receiverLength + 1;
+    memcpy(msg->content, text, payload->contentLength + 1);
+}
+
+/**
+  * Free the heap text of a payload, if it has one.
+  */
+static void freePayloadText(CachePayload *payload) {
+    char *text = payloadText(payload);
+    if (text != payload->text) {
+        free(text);
+    }
+}
+
+/**
+  * Free the payload of an entry that leaves the cache, then give its slot back to the slab.
+  */
+static void releaseEntry(Cache *cache, CacheHashEntry *entry) {
+    freePayloadText(SLAB_PAYLOAD(&cache->slab, entry));
+    slabFree(&cache->slab, entry);
+}
+
+/**
+  * Next state of the cache's xorshift64* generator.
+  */
+static uint64_t nextRandomState(uint64_t x) {
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x;
+}
+
+/**
+  * Next number of the cache's xorshift64* generator, much cheaper than reseeding rand().
+  */
+static uint32_t cacheRandom(Cache *cache) {
+    cache->randomState = nextRandomState(cache->randomState);
+    return (uint32_t)((cache->randomState * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/**
+  * The number cacheRandom returns next, without drawing it.
+  */
+static uint32_t peekRandom(const Cache *cache) {
+    return (uint32_t)((nextRandomState(cache->randomState) * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/**
+  * Index in Cache.resident of the victim of the random replacement for a draw.
+  */
+static int randomVictim(const Cache *cache, uint32_t draw) {
+    return (int)(((uint64_t)draw * (uint64_t)cache->count) >> 32);
+}
+
+/**
+  * Append an entry to the dense array of cached entries.
+  */
+static void residentAdd(Cache *cache, CacheHashEntry *entry) {
+    entry->residentIndex = cache->count;
+    cache->resident[cache->count++] = entry;
+}
+
+/**
+  * Remove an entry from the dense array of cached entries by moving the last one into its place.
+  */
+static void residentRemove(Cache *cache, CacheHashEntry *entry) {
+    CacheHashEntry *last = cache->resident[--cache->count];
+    cache->resident[entry->residentIndex] = last;
+    last->residentIndex = entry->residentIndex;
+}
+
+/**
+  * Drop an entry from the cache: unlink it from the index and the dense array, and free it.
+  * The replacement strategy has already taken it off its own lists.
+  */
+static void evictEntry(Cache *cache, CacheHashEntry *entry) {
+    indexUnlink(cache, entry);
+    residentRemove(cache, entry);
+    releaseEntry(cache, entry);
+}
+
+/**
+  * Allocate a pool of capacity ghost nodes, all free, and the hash table that indexes the ghosts in use.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+static int initGhostPool(CacheHashEntry **pool, CacheHashEntry **freeGhosts, CacheHashTable *ghosts, int capacity) {
+    *pool = (CacheHashEntry*)malloc(capacity * sizeof(CacheHashEntry));
+    if (*pool == NULL || cacheTableInit(ghosts, capacity) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < capacity; i++) {
+        (*pool)[i].next = i + 1 < capacity ? &(*pool)[i + 1] : NULL;
+    }
+    *freeGhosts = &(*pool)[0];
+    return 0;
+}
+
+/**
+  * Allocate the lists of the replacement strategies that need more than the LRU list, and the frequency
+  * sketch of the admission.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+static int initPolicyState(Cache *cache) {
+    int capacity = cache->config.capacity;
+    if (cache->config.admission && sketchInit(&cache->sketch, capacity) != 0) {
+        return -1;
+    }
+    if (cache->config.repStrategy == REP_LFU) {
+        cache->lfuBuckets = (LRUCache*)calloc(LFU_MAX_FREQUENCY + 1, sizeof(LRUCache));
+        return cache->lfuBuckets != NULL ? 0 : -1;
+    }
+    if (cache->config.repStrategy == REP_ARC) {
+        cache->arc = (ArcState*)calloc(1, sizeof(ArcState));
+        if (cache->arc == NULL) {
+            return -1;
+        }
+        return initGhostPool(&cache->arc->ghostPool, &cache->arc->freeGhosts, &cache->arc->ghosts, capacity);
+    }
+    if (cache->config.repStrategy == REP_LIRS) {
+        cache->lirs = (LirsState*)calloc(1, sizeof(LirsState));
+        if (cache->lirs == NULL) {
+            return -1;
+        }
+        int hirPercent = cache->config.lirsHirPercent > 0 && cache->config.lirsHirPercent < 100
+                         ? cache->config.lirsHirPercent : LIRS_DEFAULT_HIR_PERCENT;
+        int hirLimit = capacity * hirPercent / 100 > 0 ? capacity * hirPercent / 100 : 1;
+        cache->lirs->lirLimit = capacity - hirLimit > 0 ? capacity - hirLimit : 1;
+        cache->lirs->queueNodes = (LRUNode*)malloc(capacity * sizeof(LRUNode));
+        if (cache->lirs->queueNodes == NULL) {
+            return -1;
+        }
+        return initGhostPool(&cache->lirs->ghostPool, &cache->lirs->freeGhosts, &cache->lirs->ghosts, capacity);
+    }
+    return 0;
+}
+
+/**
+  * Free the lists and the sketch allocated by initPolicyState.
+  */
+static void freePolicyState(Cache *cache) {
+    sketchFree(&cache->sketch);
+    free(cache->lfuBuckets);
+    cache->lfuBuckets = NULL;
+    if (cache->arc != NULL) {
+        cacheTableDestroy(&cache->arc->ghosts);
+        free(cache->arc->ghostPool);
+        free(cache->arc);
+        cache->arc = NULL;
+    }
+    if (cache->lirs != NULL) {
+        cacheTableDestroy(&cache->lirs->ghosts);
+        free(cache->lirs->ghostPool);
+        free(cache->lirs->queueNodes);
+        free(cache->lirs);
+        cache->lirs = NULL;
+    }
+}
+
+/**
+  * Create an empty cache.
+  *
+  * Parameters:
+  * - config: Pointer to CacheConfig structure. A capacity <= 0 means CACHE_SIZE; initialBuckets is only a hint,
+  *   the hash table grows and shrinks with the number of cached messages. indexType picks the chained
+  *   hash table or the open-addressing Swiss table. The entries come from a slab of capacity slots,
+  *   backed by transparent huge pages if hugePages is set. seed seeds the random replacement (0: the clock),
+  *   lfuAgingPeriod sets how often LFU halves its frequencies (0: never), slruProtectedPercent the share of
+  *   an SLRU cache for entries hit twice (0: SLRU_DEFAULT_PROTECTED_PERCENT). admission puts TinyLFU in front
+  *   of the replacement strategy. lirsHirPercent is the share of a LIRS cache for resident HIR entries
+  *   (0: LIRS_DEFAULT_HIR_PERCENT). deliveredTtl (ms) makes delivered messages leave the cache after that long
+  *   (0: never).
+  *
+  * return value:
+  * - Cache*: Pointer to the new cache, to be released with destroyCache. If memory allocation fails, NULL is returned.
+  */
+Cache* createCache(const CacheConfig *config) {
+    Cache *cache = (Cache*)malloc(sizeof(Cache));
+    if (cache == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for Cache.\n");
+        return NULL;
+    }
+    cache->config = *config;
+    if (cache->config.capacity <= 0) {
+        cache->config.capacity = CACHE_SIZE;
+    }
+    cache->lru = (LRUCache){ NULL, NULL };
+    cache->count = 0;
+    cache->clockHand = 0;
+    cache->expireCursor = 0;
+    cache->lfuBuckets = NULL;
+    cache->lfuMinFrequency = 1;
+    cache->lfuEpoch = 0;
+    cache->lfuAccesses = 0;
+    uint64_t seed = cache->config.seed != 0 ? cache->config.seed : (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)cache;
+    cache->randomState = seed * 0x9E3779B97F4A7C15ull | 1;   //xorshift needs a non-zero state
+    cache->arc = NULL;
+    cache->lirs = NULL;
+    cache->slruProbation = (LRUCache){ NULL, NULL };
+    cache->slruProtected = (LRUCache){ NULL, NULL };
+    cache->slruProtectedCount = 0;
+    int protectedPercent = cache->config.slruProtectedPercent > 0 && cache->config.slruProtectedPercent < 100
+                           ? cache->config.slruProtectedPercent : SLRU_DEFAULT_PROTECTED_PERCENT;
+    cache->slruProtectedLimit = cache->config.capacity * protectedPercent / 100;
+    cache->sketch = (FrequencySketch){ NULL, NULL, 0, 0, 0, 0 };
+    cache->resident = (CacheHashEntry**)malloc(cache->config.capacity * sizeof(CacheHashEntry*));
+    if (cache->resident == NULL || initPolicyState(cache) != 0) {
+        fprintf(stderr, "Error: Memory allocation failed for Cache.\n");
+        free(cache->resident);
+        freePolicyState(cache);
+        free(cache);
+        return NULL;
+    }
+    int initialized;
+    if (cache->config.indexType == CACHE_INDEX_SWISS) {
+        int expected = cache->config.initialBuckets > 0 ? cache->config.initialBuckets : cache->config.capacity;
+        initialized = swissInit(&cache->swiss, expected);
+    } else {
+        initialized = cacheTableInit(&cache->table, cache->config.initialBuckets);
+    }
+    if (initialized != 0) {
+        free(cache->resident);
+        freePolicyState(cache);
+        free(cache);
+        return NULL;
+    }
+    if (slabInit(&cache->slab, cache->config.capacity, cache->config.hugePages) != 0) {
+        if (cache->config.indexType == CACHE_INDEX_SWISS) {
+            swissDestroy(&cache->swiss);
+        } else {
+            cacheTableDestroy(&cache->table);
+        }
+        free(cache->resident);
+        freePolicyState(cache);
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+/**
+  * Free a cache and all cached messages. The asynchronous retrieves loading into it are completed first.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure created by createCache.
+  */
+void destroyCache(Cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    drainRetrieves(cache);
+    if (cache->config.indexType == CACHE_INDEX_SWISS) {
+        swissDestroy(&cache->swiss);
+    } else {
+        cacheTableDestroy(&cache->table);
+    }
+    // Free the texts that live outside the slab
+    for (int i = 0; i < cache->count; i++) {
+        freePayloadText(SLAB_PAYLOAD(&cache->slab, cache->resident[i]));
+    }
+    slabDestroy(&cache->slab);
+    free(cache->resident);
+    freePolicyState(cache);
+    free(cache);
+}
+
+/**
+  * Add an LRU node to the head of the LRU cache.
+  *
+  * Parameters:
+  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
+  * - node: Pointer to the LRUNode structure, indicating the node to be added to the cache header.
+  */
+void addNodeToLRUHead(LRUCache *lruCache, LRUNode *node) {
+    node->next = lruCache->head;
+    node->prev = NULL;
+
+    if (lruCache->head != NULL) {
+        lruCache->head->prev = node;
+    }
+    lruCache->head = node;
+
+    if (lruCache->tail == NULL) {
+        lruCache->tail = node;
+    }
+}
+
+/**
+  * Remove a node from the LRU cache.
+  *
+  * Parameters:
+  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
+  * - node: Pointer to the LRUNode structure, indicating the node to be removed from the cache.
+  */
+void removeNodeFromLRU(LRUCache *lruCache, LRUNode *node) {
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    } else {
+        lruCache->head = node->next;
+    }
+
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    } else {
+        lruCache->tail = node->prev;
+    }
+}
+
+/**
+  * Move a node to the head of the LRU cache.
+  *
+  * Parameters:
+  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
+  * - node: Pointer to the LRUNode structure, indicating the node to be moved.
+  */
+void moveToHead(LRUCache *lruCache, LRUNode *node) {
+    removeNodeFromLRU(lruCache, node);
+    addNodeToLRUHead(lruCache, node);
+}
+
+
+/**
+  * Get the current timestamp in milliseconds.
+  *
+  * return value:
+  * - long long: The current millisecond timestamp.
+  */
+long long current_timestamp_ms() {
+    struct timespec spec;
+    clock_gettime(CLOCK_REALTIME, &spec);
+    //Convert seconds and nanoseconds to milliseconds
+    long long milliseconds = spec.tv_sec * 1000LL + spec.tv_nsec / 1000000;
+    return milliseconds;
+}
+
+/**
+  * Implement a random replacement policy to remove an entry from the cache.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
+  */
+int randomReplacement(Cache *cache) {
+    // cache is empty
+    if (cache->count == 0) {
+        return -1;
+    }
+
+    // Randomly select a cached entry for replacement: one draw over the dense array of cached entries
+    int victim = randomVictim(cache, cacheRandom(cache));
+    CacheHashEntry *current = cache->resident[victim];
+
+    // Perform replacement
+    int replacedKey = current->key;
+    removeNodeFromLRU(&cache->lru, &current->lruNode);
+    evictEntry(cache, current);
+
+    printf("Randomly replaced message ID：%d has been removed from cache\n", replacedKey);
+    return replacedKey;
+}
+
+
+
+/**
+  * Remove an entry from the cache using the least recently used (LRU) policy.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the LRU cache is empty, -1 is returned.
+  */
+int lruReplacement(Cache *cache) {
+    if (cache->lru.tail == NULL) {
+        return -1;
+    }
+
+    // The tail node is embedded in the least recently used entry, no hash lookup is needed to find it
+    CacheHashEntry *current = LRU_ENTRY(cache->lru.tail);
+    int replacedKey = current->key;
+
+    //Delete the last LRUNode and unlink its entry from the hash table
+    removeNodeFromLRU(&cache->lru, &current->lruNode);
+    evictEntry(cache, current);
+
+    printf("Least recently used message ID：%d has been removed from cache\n", replacedKey);
+    return replacedKey;
+}
+
+/**
+  * Move the CLOCK hand to the next cached entry without a reference bit, clearing the bits it passes.
+  */
+static CacheHashEntry* clockSweep(Cache *cache) {
+    while (true) {
+        if (cache->clockHand >= cache->count) {
+            cache->clockHand = 0;
+        }
+        CacheHashEntry *current = cache->resident[cache->clockHand];
+        if (!current->referenced) {
+            return current;
+        }
+        current->referenced = false;
+        cache->clockHand++;
+    }
+}
+
+/**
+  * The entry clockSweep would stop at, found without clearing reference bits or moving the hand:
+  * the first entry from the hand on without a reference bit, or the one under the hand if all have it.
+  */
+static CacheHashEntry* clockPeek(const Cache *cache) {
+    int start = cache->clockHand < cache->count ? cache->clockHand : 0;
+    for (int i = 0; i < cache->count; i++) {
+        CacheHashEntry *current = cache->resident[(start + i) % cache->count];
+        if (!current->referenced) {
+            return current;
+        }
+    }
+    return cache->resident[start];
+}
+
+/**
+  * Remove an entry from the cache using the CLOCK (second chance) policy. The hand sweeps the cached entries:
+  * an entry hit since the hand last passed loses its reference bit and is skipped, the first one without
+  * it is replaced. The sweep ends within two rounds.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
+  */
+int clockReplacement(Cache *cache) {
+    if (cache->count == 0) {
+        return -1;
+    }
+
+    CacheHashEntry *current = clockSweep(cache);
+
+    // The last entry moves into the hand's place and is looked at next
+    int replacedKey = current->key;
+    evictEntry(cache, current);
+
+    printf("CLOCK replaced message ID：%d has been removed from cache\n", replacedKey);
+    return replacedKey;
+}
+
+/**
+  * Move all entries of one list in front of the entries of another, in O(1).
+  */
+static void spliceToHead(LRUCache *to, LRUCache *from) {
+    if (from->head == NULL) {
+        return;
+    }
+    if (to->head == NULL) {
+        to->tail = from->tail;
+    } else {
+        from->tail->next = to->head;
+        to->head->prev = from->tail;
+    }
+    to->head = from->head;
+    from->head = NULL;
+    from->tail = NULL;
+}
+
+/**
+  * Halve the frequencies of all LFU entries. Each frequency list is moved as a whole to the list of half
+  * its frequency, ahead of the entries already there, which costs O(LFU_MAX_FREQUENCY) however many entries
+  * are cached. The frequency stored in an entry is brought up to date the next time the entry is touched.
+  */
+static void lfuAge(Cache *cache) {
+    for (int frequency = 2; frequency <= LFU_MAX_FREQUENCY; frequency++) {
+        spliceToHead(&cache->lfuBuckets[frequency / 2], &cache->lfuBuckets[frequency]);
+    }
+    cache->lfuEpoch++;
+    cache->lfuMinFrequency = 1;
+}
+
+/**
+  * Frequency of an LFU entry after the agings it missed, which is also the list it is in.
+  */
+static int lfuFrequency(Cache *cache, CacheHashEntry *entry) {
+    int missed = cache->lfuEpoch - entry->lfuEpoch;
+    int frequency = missed >= 8 ? 1 : entry->frequency >> missed;
+    return frequency > 0 ? frequency : 1;
+}
+
+/**
+  * Count an access for LFU aging.
+  */
+static void lfuCountAccess(Cache *cache) {
+    if (cache->config.lfuAgingPeriod > 0 && ++cache->lfuAccesses >= cache->config.lfuAgingPeriod) {
+        cache->lfuAccesses = 0;
+        lfuAge(cache);
+    }
+}
+
+/**
+  * Move an LFU entry that was hit to the list of the next frequency.
+  */
+static void lfuHit(Cache *cache, CacheHashEntry *entry) {
+    int frequency = lfuFrequency(cache, entry);
+    int next = frequency < LFU_MAX_FREQUENCY ? frequency + 1 : frequency;
+    removeNodeFromLRU(&cache->lfuBuckets[frequency], &entry->lruNode);
+    addNodeToLRUHead(&cache->lfuBuckets[next], &entry->lruNode);
+    entry->frequency = (unsigned char)next;
+    entry->lfuEpoch = cache->lfuEpoch;
+    if (frequency == cache->lfuMinFrequency && cache->lfuBuckets[frequency].head == NULL) {
+        cache->lfuMinFrequency = next;
+    }
+    lfuCountAccess(cache);
+}
+
+/**
+  * Add a new entry to LFU with frequency 1.
+  */
+static void lfuInsert(Cache *cache, CacheHashEntry *entry) {
+    entry->frequency = 1;
+    entry->lfuEpoch = cache->lfuEpoch;
+    addNodeToLRUHead(&cache->lfuBuckets[1], &entry->lruNode);
+    cache->lfuMinFrequency = 1;
+    lfuCountAccess(cache);
+}
+
+/**
+  * The list of the lowest frequency that has entries, the cache must not be empty.
+  */
+static LRUCache* lfuLowestBucket(Cache *cache) {
+    // An eviction or an aging may have emptied the lowest list, the next one is at most LFU_MAX_FREQUENCY away
+    while (cache->lfuBuckets[cache->lfuMinFrequency].tail == NULL) {
+        cache->lfuMinFrequency++;
+    }
+    return &cache->lfuBuckets[cache->lfuMinFrequency];
+}
+
+/**
+  * Remove an entry from the cache using the least frequently used (LFU) policy: the least recently used entry
+  * of the lowest frequency. Entries sit in one list per frequency, so this and every hit cost O(1).
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
+  */
+int lfuReplacement(Cache *cache) {
+    if (cache->count == 0) {
+        return -1;
+    }
+    LRUCache *bucket = lfuLowestBucket(cache);
+    CacheHashEntry *current = LRU_ENTRY(bucket->tail);
+    int replacedKey = current->key;
+    removeNodeFromLRU(bucket, &current->lruNode);
+    evictEntry(cache, current);
+
+    printf("Least frequently used message ID：%d has been removed from cache\n", replacedKey);
+    return replacedKey;
+}
+
+/**
+  * Forget an ARC ghost: take it off its list and out of the ghost table, and put it back in the pool.
+  */
+static void arcDropGhost(ArcState *arc, CacheHashEntry *ghost) {
+    if (ghost->segment == ARC_B1) {
+        removeNodeFromLRU(&arc->b1, &ghost->lruNode);
+        arc->b1Size--;
+    } else {
+        removeNodeFromLRU(&arc->b2, &ghost->lruNode);
+        arc->b2Size--;
+    }
+    cacheTableUnlink(&arc->ghosts, ghost);
+    ghost->next = arc->freeGhosts;
+    arc->freeGhosts = ghost;
+}
+
+/**
+  * Remember the key of an entry evicted from T1 (in B1) or T2 (in B2).
+  */
+static void arcAddGhost(ArcState *arc, int key, int segment) {
+    if (arc->freeGhosts == NULL) {
+        //Not reached while the ghost lists keep within the capacity, but never grow past the pool
+        arcDropGhost(arc, LRU_ENTRY(arc->b2.tail != NULL ? arc->b2.tail : arc->b1.tail));
+    }
+    CacheHashEntry *ghost = arc->freeGhosts;
+    arc->freeGhosts = ghost->next;
+    ghost->key = key;
+    ghost->segment = (unsigned char)segment;
+    cacheTableInsert(&arc->ghosts, ghost);
+    if (segment == ARC_B1) {
+        addNodeToLRUHead(&arc->b1, &ghost->lruNode);
+        arc->b1Size++;
+    } else {
+        addNodeToLRUHead(&arc->b2, &ghost->lruNode);
+        arc->b2Size++;
+    }
+}
+
+/**
+  * Prepare ARC for a message about to be stored, before the cache makes room for it. A ghost hit adapts the
+  * target size of T1 (towards recency on B1, towards frequency on B2) and sends the message to T2; any other
+  * message goes to T1, and the ghost lists are trimmed so that T1 + B1 and all four lists keep within
+  * one and two capacities.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  * - key: integer, identifier of the message to be stored.
+  */
+static void arcPrepare(Cache *cache, int key) {
+    ArcState *arc = cache->arc;
+    int capacity = cache->config.capacity;
+    arc->incomingFromB2 = false;
+    arc->dropVictim = false;
+    CacheHashEntry *ghost = cacheTableFind(&arc->ghosts, key);
+    if (ghost != NULL && ghost->segment == ARC_B1) {
+        int delta = arc->b1Size >= arc->b2Size ? 1 : arc->b2Size / arc->b1Size;
+        arc->target = arc->target + delta < capacity ? arc->target + delta : capacity;
+        arcDropGhost(arc, ghost);
+        arc->incoming = ARC_T2;
+    } else if (ghost != NULL) {
+        int delta = arc->b2Size >= arc->b1Size ? 1 : arc->b1Size / arc->b2Size;
+        arc->target = arc->target - delta > 0 ? arc->target - delta : 0;
+        arcDropGhost(arc, ghost);
+        arc->incoming = ARC_T2;
+        arc->incomingFromB2 = true;
+    } else {
+        arc->incoming = ARC_T1;
+        if (arc->t1Size + arc->b1Size >= capacity) {
+            if (arc->t1Size < capacity) {
+                arcDropGhost(arc, LRU_ENTRY(arc->b1.tail));
+            } else {
+                arc->dropVictim = true;
+            }
+        } else if (arc->t1Size + arc->t2Size + arc->b1Size + arc->b2Size >= 2 * capacity && arc->b2.tail != NULL) {
+            arcDropGhost(arc, LRU_ENTRY(arc->b2.tail));
+        }
+    }
+}
+
+/**
+  * Add a stored message to the list chosen by arcPrepare.
+  */
+static void arcInsert(Cache *cache, CacheHashEntry *entry) {
+    ArcState *arc = cache->arc;
+    entry->segment = (unsigned char)arc->incoming;
+    if (arc->incoming == ARC_T2) {
+        addNodeToLRUHead(&arc->t2, &entry->lruNode);
+        arc->t2Size++;
+    } else {
+        addNodeToLRUHead(&arc->t1, &entry->lruNode);
+        arc->t1Size++;
+    }
+    arc->incoming = ARC_T1;
+}
+
+/**
+  * A hit moves an ARC entry to the head of T2, it has now been seen at least twice.
+  */
+static void arcHit(Cache *cache, CacheHashEntry *entry) {
+    ArcState *arc = cache->arc;
+    if (entry->segment == ARC_T1) {
+        removeNodeFromLRU(&arc->t1, &entry->lruNode);
+        arc->t1Size--;
+        addNodeToLRUHead(&arc->t2, &entry->lruNode);
+        arc->t2Size++;
+        entry->segment = ARC_T2;
+    } else {
+        moveToHead(&arc->t2, &entry->lruNode);
+    }
+}
+
+/**
+  * Whether the next ARC victim is the least recently used entry of T1 (else of T2).
+  */
+static bool arcEvictsFromT1(const ArcState *arc) {
+    if (arc->t2Size == 0) {
+        return true;
+    }
+    if (arc->t1Size == 0) {
+        return false;
+    }
+    return arc->t1Size > arc->target || (arc->incomingFromB2 && arc->t1Size == arc->target);
+}
+
+/**
+  * Remove an entry from the cache using the Adaptive Replacement Cache (ARC) policy: the least recently used
+  * entry of T1 while T1 is above its target size, else the one of T2. The key of the victim is kept as a ghost,
+  * so that storing it again soon tells which of the two lists evicted too early. Every step is O(1).
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
+  */
+int arcReplacement(Cache *cache) {
+    if (cache->count == 0) {
+        return -1;
+    }
+    ArcState *arc = cache->arc;
+    bool fromT1 = arcEvictsFromT1(arc);
+    LRUCache *list = fromT1 ? &arc->t1 : &arc->t2;
+    CacheHashEntry *current = LRU_ENTRY(list->tail);
+    int replacedKey = current->key;
+    removeNodeFromLRU(list, &current->lruNode);
+    if (fromT1) {
+        arc->t1Size--;
+    } else {
+        arc->t2Size--;
+    }
+    evictEntry(cache, current);
+    if (!(fromT1 && arc->dropVictim)) {
+        arcAddGhost(arc, replacedKey, fromT1 ? ARC_B1 : ARC_B2);
+    }
+    arc->dropVictim = false;
+    arc->incomingFromB2 = false;
+
+    printf("ARC replaced message ID：%d has been removed from cache (from %s)\n", replacedKey, fromT1 ? "T1" : "T2");
+    return replacedKey;
+}
+
+/**
+  * A hit on an SLRU entry: in probation it is promoted to the head of the protected segment, whose least
+  * recently used entry drops back to the head of probation if the segment is over its limit; in protected
+  * it moves to the head.
+  */
+static void slruHit(Cache *cache, CacheHashEntry *entry) {
+    if (entry->segment == SLRU_PROTECTED) {
+        moveToHead(&cache->slruProtected, &entry->lruNode);
+        return;
+    }
+    removeNodeFromLRU(&cache->slruProbation, &entry->lruNode);
+    addNodeToLRUHead(&cache->slruProtected, &entry->lruNode);
+    entry->segment = SLRU_PROTECTED;
+    if (++cache->slruProtectedCount > cache->slruProtectedLimit) {
+        CacheHashEntry *demoted = LRU_ENTRY(cache->slruProtected.tail);
+        removeNodeFromLRU(&cache->slruProtected, &demoted->lruNode);
+        addNodeToLRUHead(&cache->slruProbation, &demoted->lruNode);
+        demoted->segment = SLRU_PROBATION;
+        cache->slruProtectedCount--;
+    }
+}
+
+/**
+  * Remove an entry from the cache using the segmented LRU (SLRU) policy: the least recently used entry of
+  * probation, which only holds entries that were not hit again since they were stored (or that were demoted).
+  * A scan of messages read once thus only cycles through probation and leaves the protected working set alone.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
+  */
+int slruReplacement(Cache *cache) {
+    if (cache->count == 0) {
+        return -1;
+    }
+    CacheHashEntry *current;
+    if (cache->slruProbation.tail != NULL) {
+        current = LRU_ENTRY(cache->slruProbation.tail);
+        removeNodeFromLRU(&cache->slruProbation, &current->lruNode);
+    } else {
+        current = LRU_ENTRY(cache->slruProtected.tail);
+        removeNodeFromLRU(&cache->slruProtected, &current->lruNode);
+        cache->slruProtectedCount--;
+    }
+    int replacedKey = current->key;
+    evictEntry(cache, current);
+
+    printf("SLRU replaced message ID：%d has been removed from cache\n", replacedKey);
+    return replacedKey;
+}
+
+//The queue node of a resident LIRS entry, and the entry of a queue node: both live at the index of the slab slot
+#define LIRS_QUEUE_NODE(cache, entry) (&(cache)->lirs->queueNodes[(entry) - (cache)->slab.slots])
+#define LIRS_QUEUE_ENTRY(cache, node) (&(cache)->slab.slots[(node) - (cache)->lirs->queueNodes])
+
+/**
+  * Put a node in the place of another one in a list.
+  */
+static void replaceNodeInLRU(LRUCache *lruCache, LRUNode *old, LRUNode *node) {
+    node->prev = old->prev;
+    node->next = old->next;
+    if (old->prev != NULL) {
+        old->prev->next = node;
+    } else {
+        lruCache->head = node;
+    }
+    if (old->next != NULL) {
+        old->next->prev = node;
+    } else {
+        lruCache->tail = node;
+    }
+}
 
 /**
-  * Add an LRU node to the head of the LRU cache.
-  *
-  * Parameters:
-  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
-  * - node: Pointer to the LRUNode structure, indicating the node to be added to the cache header.
+  * Forget a LIRS ghost: take it out of the ghost table and put it back in the pool. It is already off the stack.
   */
-void addNodeToLRUHead(LRUCache *lruCache, LRUNode *node) {
-    node->next = lruCache->head;
-    node->prev = NULL;
+static void lirsDropGhost(LirsState *lirs, CacheHashEntry *ghost) {
+    cacheTableUnlink(&lirs->ghosts, ghost);
+    ghost->next = lirs->freeGhosts;
+    lirs->freeGhosts = ghost;
+}
 
-    if (lruCache->head != NULL) {
-        lruCache->head->prev = node;
+/**
+  * Take the HIR entries and ghosts off the bottom of the stack until an LIR entry is there. They are older than
+  * every LIR entry, so a new access to them could not make them LIR: ghosts are forgotten, resident HIR entries
+  * stay in the queue.
+  */
+static void lirsPrune(LirsState *lirs) {
+    while (lirs->stack.tail != NULL) {
+        CacheHashEntry *bottom = LRU_ENTRY(lirs->stack.tail);
+        if (bottom->segment == LIRS_LIR) {
+            return;
+        }
+        removeNodeFromLRU(&lirs->stack, &bottom->lruNode);
+        if (bottom->segment == LIRS_GHOST) {
+            lirsDropGhost(lirs, bottom);
+        } else {
+            bottom->segment = LIRS_HIR;
+        }
     }
-    lruCache->head = node;
+}
 
-    if (lruCache->tail == NULL) {
-        lruCache->tail = node;
+/**
+  * Turn LIR entries at the bottom of the stack into resident HIR entries at the head of the queue
+  * until no more than lirLimit are LIR.
+  */
+static void lirsDemote(Cache *cache) {
+    LirsState *lirs = cache->lirs;
+    while (lirs->lirCount > lirs->lirLimit) {
+        CacheHashEntry *bottom = LRU_ENTRY(lirs->stack.tail);
+        removeNodeFromLRU(&lirs->stack, &bottom->lruNode);
+        bottom->segment = LIRS_HIR;
+        addNodeToLRUHead(&lirs->queue, LIRS_QUEUE_NODE(cache, bottom));
+        lirs->lirCount--;
+        lirsPrune(lirs);
     }
 }
 
 /**
-  * Remove a node from the LRU cache.
+  * Prepare LIRS for a message about to be stored: if it is still a ghost in the stack, its reuse distance
+  * is shorter than that of the oldest LIR entry, so it will be stored as LIR.
   *
   * Parameters:
-  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
-  * - node: Pointer to the LRUNode structure, indicating the node to be removed from the cache.
+  * - cache: Pointer to Cache structure.
+  * - key: integer, identifier of the message to be stored.
   */
-void removeNodeFromLRU(LRUCache *lruCache, LRUNode *node) {
-    if (node->prev != NULL) {
-        node->prev->next = node->next;
-    } else {
-        lruCache->head = node->next;
+static void lirsPrepare(Cache *cache, int key) {
+    LirsState *lirs = cache->lirs;
+    CacheHashEntry *ghost = cacheTableFind(&lirs->ghosts, key);
+    lirs->incomingLir = ghost != NULL;
+    if (ghost != NULL) {
+        //The bottom of the stack is LIR, so the ghost is not at the bottom and no pruning is needed
+        removeNodeFromLRU(&lirs->stack, &ghost->lruNode);
+        lirsDropGhost(lirs, ghost);
     }
+}
 
-    if (node->next != NULL) {
-        node->next->prev = node->prev;
+/**
+  * Add a stored message to the top of the stack: as LIR while the LIR entries are fewer than lirLimit or if it
+  * was a ghost, else as a resident HIR entry that also goes to the head of the queue.
+  */
+static void lirsInsert(Cache *cache, CacheHashEntry *entry) {
+    LirsState *lirs = cache->lirs;
+    addNodeToLRUHead(&lirs->stack, &entry->lruNode);
+    if (lirs->incomingLir || lirs->lirCount < lirs->lirLimit) {
+        entry->segment = LIRS_LIR;
+        lirs->lirCount++;
+        lirsDemote(cache);
     } else {
-        lruCache->tail = node->prev;
+        entry->segment = LIRS_HIR_STACKED;
+        addNodeToLRUHead(&lirs->queue, LIRS_QUEUE_NODE(cache, entry));
     }
+    lirs->incomingLir = false;
 }
 
 /**
-  * Move a node to the head of the LRU cache.
-  *
-  * Parameters:
-  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
-  * - node: Pointer to the LRUNode structure, indicating the node to be moved.
+  * A hit on a LIRS entry. An LIR entry moves to the top of the stack. A resident HIR entry still in the stack
+  * was reused sooner than the oldest LIR entry: it becomes LIR and the bottom LIR entry becomes HIR. Any other
+  * HIR entry goes back to the top of the stack and to the head of the queue.
   */
-void moveToHead(LRUCache *lruCache, LRUNode *node) {
-    removeNodeFromLRU(lruCache, node);
-    addNodeToLRUHead(lruCache, node);
+static void lirsHit(Cache *cache, CacheHashEntry *entry) {
+    LirsState *lirs = cache->lirs;
+    if (entry->segment == LIRS_LIR) {
+        bool bottom = lirs->stack.tail == &entry->lruNode;
+        moveToHead(&lirs->stack, &entry->lruNode);
+        if (bottom) {
+            lirsPrune(lirs);
+        }
+    } else if (entry->segment == LIRS_HIR_STACKED) {
+        removeNodeFromLRU(&lirs->queue, LIRS_QUEUE_NODE(cache, entry));
+        moveToHead(&lirs->stack, &entry->lruNode);
+        entry->segment = LIRS_LIR;
+        lirs->lirCount++;
+        lirsDemote(cache);
+    } else {
+        addNodeToLRUHead(&lirs->stack, &entry->lruNode);
+        entry->segment = LIRS_HIR_STACKED;
+        moveToHead(&lirs->queue, LIRS_QUEUE_NODE(cache, entry));
+    }
 }
 
-
 /**
-  * Get the current timestamp in milliseconds.
-  *
-  * return value:
-  * - long long: The current millisecond timestamp.
+  * The entry LIRS evicts next: the tail of the queue, or the bottom LIR entry if no HIR entry is resident.
   */
-long long current_timestamp_ms() {
-    struct timespec spec;
-    clock_gettime(CLOCK_REALTIME, &spec);
-    //Convert seconds and nanoseconds to milliseconds
-    long long milliseconds = spec.tv_sec * 1000LL + spec.tv_nsec / 1000000;
-    return milliseconds;
+static CacheHashEntry* lirsVictim(Cache *cache) {
+    LirsState *lirs = cache->lirs;
+    if (lirs->queue.tail != NULL) {
+        return LIRS_QUEUE_ENTRY(cache, lirs->queue.tail);
+    }
+    return LRU_ENTRY(lirs->stack.tail);
 }
 
 /**
-  * Implement a random replacement policy to remove an entry from the cache.
+  * Remove an entry from the cache using the Low Inter-reference Recency Set (LIRS) policy: the oldest resident
+  * HIR entry. LIR entries, whose last two accesses were close together, are only evicted after they were demoted
+  * to HIR, so a loop over slightly more messages than the cache holds keeps most of them cached instead of
+  * missing on every access as with LRU. A victim still in the stack stays there as a ghost. Amortized O(1).
   *
   * Parameters:
-  * - cacheHashTable[]: cache hash table array.
-  * - hashTableSize: Hash table size.
-  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
-  * - cacheCount: Pointer to an integer representing the number of entries currently in the cache.
+  * - cache: Pointer to Cache structure.
   *
   * return value:
   * - int: Key of the cache entry being replaced. If the cache is empty, -1 is returned.
   */
-int randomReplacement(CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount) {
-    // cache is empty
-    if (*cacheCount == 0) {
+int lirsReplacement(Cache *cache) {
+    if (cache->count == 0) {
         return -1;
     }
-
-    // Randomly select a hash bucket index
-    srand((unsigned int)time(NULL));
-    int hashIndex = rand() % hashTableSize;
-    CacheHashEntry *current = cacheHashTable[hashIndex];
-    CacheHashEntry *prev = NULL;
-
-    // If the selected hash bucket is empty, traverse to find a non-empty one
-    while (current == NULL) {
-        hashIndex = (hashIndex + 1) % hashTableSize;
-        current = cacheHashTable[hashIndex];
-    }
-
-    // Randomly select an entry within the selected bucket for replacement
-    int entriesInBucket = 0;
-    CacheHashEntry *temp = current;
-    while (temp != NULL) {
-        entriesInBucket++;
-        temp = temp->next;
-    }
-
-    int randomEntryIndex = rand() % entriesInBucket;
-    for (int i = 0; i < randomEntryIndex; i++) {
-        prev = current;
-        current = current->next;
-    }
-
-    // Perform replacement
+    LirsState *lirs = cache->lirs;
+    CacheHashEntry *current = lirsVictim(cache);
     int replacedKey = current->key;
-    removeNodeFromLRU(lruCache, current->lrNode);
-    free(current->lrNode);
-
-    if (prev == NULL) {
-        cacheHashTable[hashIndex] = current->next;
+    if (current->segment == LIRS_LIR) {
+        removeNodeFromLRU(&lirs->stack, &current->lruNode);
+        lirs->lirCount--;
+        lirsPrune(lirs);
     } else {
-        prev->next = current->next;
+        removeNodeFromLRU(&lirs->queue, LIRS_QUEUE_NODE(cache, current));
+        if (current->segment == LIRS_HIR_STACKED) {
+            //Without a free ghost node the victim just leaves the stack, it is not at its bottom either way
+            CacheHashEntry *ghost = lirs->freeGhosts;
+            if (ghost != NULL) {
+                lirs->freeGhosts = ghost->next;
+                ghost->key = replacedKey;
+                ghost->segment = LIRS_GHOST;
+                replaceNodeInLRU(&lirs->stack, &current->lruNode, &ghost->lruNode);
+                cacheTableInsert(&lirs->ghosts, ghost);
+            } else {
+                removeNodeFromLRU(&lirs->stack, &current->lruNode);
+            }
+        }
     }
+    evictEntry(cache, current);
 
-    free(current);
-    (*cacheCount)--;
-
-    printf("Randomly replaced message ID：%d has been removed from cache\n", replacedKey);
+    printf("LIRS replaced message ID：%d has been removed from cache\n", replacedKey);
     return replacedKey;
 }
 
+/**
+  * Take an entry off the lists of the replacement strategy, wherever it is in them. The entry leaves no ghost:
+  * it did not have to make room for another message.
+  */
+static void removeFromPolicy(Cache *cache, CacheHashEntry *entry) {
+    int strategy = cache->config.repStrategy;
+    if (strategy == REP_CLOCK) {
+        return;    //the hand only walks the dense array of cached entries
+    } else if (strategy == REP_LFU) {
+        removeNodeFromLRU(&cache->lfuBuckets[lfuFrequency(cache, entry)], &entry->lruNode);
+    } else if (strategy == REP_ARC) {
+        if (entry->segment == ARC_T1) {
+            removeNodeFromLRU(&cache->arc->t1, &entry->lruNode);
+            cache->arc->t1Size--;
+        } else {
+            removeNodeFromLRU(&cache->arc->t2, &entry->lruNode);
+            cache->arc->t2Size--;
+        }
+    } else if (strategy == REP_SLRU) {
+        if (entry->segment == SLRU_PROTECTED) {
+            removeNodeFromLRU(&cache->slruProtected, &entry->lruNode);
+            cache->slruProtectedCount--;
+        } else {
+            removeNodeFromLRU(&cache->slruProbation, &entry->lruNode);
+        }
+    } else if (strategy == REP_LIRS) {
+        LirsState *lirs = cache->lirs;
+        if (entry->segment != LIRS_LIR) {
+            removeNodeFromLRU(&lirs->queue, LIRS_QUEUE_NODE(cache, entry));
+        }
+        if (entry->segment != LIRS_HIR) {
+            removeNodeFromLRU(&lirs->stack, &entry->lruNode);
+        }
+        if (entry->segment == LIRS_LIR) {
+            lirs->lirCount--;
+            lirsPrune(lirs);
+        }
+    } else {
+        removeNodeFromLRU(&cache->lru, &entry->lruNode);
+    }
+}
 
+/**
+  * Whether a cached message has outlived its time to live.
+  */
+static inline bool isExpired(const CacheHashEntry *entry, time_t now) {
+    return entry->expiresAt != 0 && now >= entry->expiresAt;
+}
 
 /**
-  * Remove an entry from the cache using the least recently used (LRU) policy.
+  * Drop a cached message whose time to live is over.
+  */
+static void expireEntry(Cache *cache, CacheHashEntry *entry) {
+    int expiredKey = entry->key;
+    removeFromPolicy(cache, entry);
+    evictEntry(cache, entry);
+    printf("Expired message ID：%d has been removed from cache\n", expiredKey);
+}
+
+/**
+  * Incremental expiry sweep: look at the next few cached messages, continuing where the last sweep stopped,
+  * and drop the delivered ones whose time to live (CacheConfig.deliveredTtl) is over. store_msg sweeps
+  * CACHE_EXPIRE_STEP messages before it makes room, so expired messages free their slots instead of live
+  * ones being evicted; lookups never sweep, they only drop the message they find expired.
   *
   * Parameters:
-  * - cacheHashTable[]: cache hash table array.
-  * - hashTableSize: Hash table size.
-  * - lruCache: Pointer to LRUCache structure, representing LRU cache.
-  * - cacheCount: Pointer to an integer representing the number of entries currently in the cache.
+  * - cache: Pointer to Cache structure.
+  * - maxChecked: integer, most cached messages looked at.
   *
   * return value:
-  * - int: Key of the cache entry being replaced. If the LRU cache is empty, -1 is returned.
+  * - int: Number of messages expired.
   */
-int lruReplacement(CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount) {
-    if (lruCache->tail == NULL) {
-        return -1;
+int expireCache(Cache *cache, int maxChecked) {
+    if (cache->config.deliveredTtl <= 0) {
+        return 0;
     }
-
-    LRUNode *lruNode = lruCache->tail;
-    int replacedKey = lruNode->key;
-
-    //Delete the last LRUNode and update the hash table
-    int hashIndex = replacedKey % hashTableSize;
-    CacheHashEntry *current = cacheHashTable[hashIndex];
-    CacheHashEntry *prev = NULL;
-    while (current != NULL) {
-        if (current->key == replacedKey) {
-            if (prev == NULL) {
-                cacheHashTable[hashIndex] = current->next;
-            } else {
-                prev->next = current->next;
-            }
-            removeNodeFromLRU(lruCache, current->lrNode);
-            free(current->lrNode);
-            free(current);
-            break;
+    time_t now = current_timestamp_ms();
+    int expired = 0;
+    for (int i = 0; i < maxChecked && cache->count > 0; i++) {
+        if (cache->expireCursor >= cache->count) {
+            cache->expireCursor = 0;
+        }
+        CacheHashEntry *entry = cache->resident[cache->expireCursor];
+        if (isExpired(entry, now)) {
+            //The last cached message moves into this index and is looked at next
+            expireEntry(cache, entry);
+            expired++;
+        } else {
+            cache->expireCursor++;
         }
-        prev = current;
-        current = current->next;
     }
+    return expired;
+}
 
-    (*cacheCount)--;
+/**
+  * The entry the replacement strategy of a full cache evicts next, without evicting it or touching the order
+  * the strategy keeps. For ARC and LIRS it is the victim as things stand before the message is prepared; for
+  * CLOCK the peek is a scan from the hand, O(n) at worst where the sweep itself is amortized O(1).
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to the next victim, or NULL if the cache is empty.
+  */
+static CacheHashEntry* nextVictim(Cache *cache) {
+    if (cache->count == 0) {
+        return NULL;
+    }
+    int strategy = cache->config.repStrategy;
+    if (strategy == REP_RANDOM) {
+        return cache->resident[randomVictim(cache, peekRandom(cache))];
+    } else if (strategy == REP_CLOCK) {
+        return clockPeek(cache);
+    } else if (strategy == REP_LFU) {
+        return LRU_ENTRY(lfuLowestBucket(cache)->tail);
+    } else if (strategy == REP_ARC) {
+        return LRU_ENTRY(arcEvictsFromT1(cache->arc) ? cache->arc->t1.tail : cache->arc->t2.tail);
+    } else if (strategy == REP_SLRU) {
+        return LRU_ENTRY(cache->slruProbation.tail != NULL ? cache->slruProbation.tail : cache->slruProtected.tail);
+    } else if (strategy == REP_LIRS) {
+        return lirsVictim(cache);
+    }
+    return LRU_ENTRY(cache->lru.tail);
+}
 
-    printf("Least recently used message ID：%d has been removed from cache\n", replacedKey);
-    return replacedKey;
+/**
+  * TinyLFU admission for a full cache: a message is only cached if the sketch estimates it was accessed
+  * more often lately than the entry it would replace, so a burst of messages read once cannot flush
+  * entries that are read again and again. There is no admission window in front of the cache (W-TinyLFU),
+  * so a tie keeps the victim: a new message has to be accessed again before it can win.
+  *
+  * Parameters:
+  * - cache: Pointer to Cache structure.
+  * - identifier: integer, identifier of the message to be cached.
+  *
+  * return value:
+  * - bool: true if the message replaces the next victim, false if it is not cached.
+  */
+static bool admitToCache(Cache *cache, int identifier) {
+    CacheHashEntry *victim = nextVictim(cache);
+    if (victim == NULL) {
+        return true;
+    }
+    int candidateFrequency = sketchEstimate(&cache->sketch, identifier);
+    int victimFrequency = sketchEstimate(&cache->sketch, victim->key);
+    if (candidateFrequency > victimFrequency) {
+        return true;
+    }
+    printf("message ID：%d is not admitted to cache (frequency %d, message ID：%d has %d)\n",
+           identifier, candidateFrequency, victim->key, victimFrequency);
+    return false;
 }
 
 /**
@@ -235,91 +1366,221 @@ Message* create_msg(int identifier, const char* sender, const char* receiver, co
 }
 
 /**
-  * Store messages in the cache and replace entries based on policy when the cache is full. At the same time, the message is saved to disk.
+  * Put a message in the cache, replacing an entry based on policy when the cache is full. With admission on,
+  * a full cache keeps its entries instead if the message is not admitted.
   *
   * Parameters:
-  * - msg: Pointer to the Message structure, indicating the message to be stored.
-  * - cacheHashTable[]: CacheHashEntry pointer array, pointing to the cache hash table.
-  * - hashTableSize: integer, indicating the size of the hash table.
-  * - lruCache: Pointer to LRUCache structure, used to maintain LRU information.
-  * - cacheCount: Pointer to the number of entries in the cache.
-  * - repStrategy: integer, indicating the replacement strategy used (0 means LRU, 1 means random).
+  * - msg: Pointer to the Message structure, indicating the message to be cached.
+  * - cache: Pointer to Cache structure, its configuration gives the capacity and the replacement strategy.
   */
-void store_msg(const Message* msg, CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount, int repStrategy) {
-    if (msg == NULL) {
+static void cacheMessage(const Message* msg, Cache *cache) {
+    int identifier = msg->identifier;
+    expireCache(cache, CACHE_EXPIRE_STEP);
+
+    //A message that is not admitted leaves the cache as it was, ARC and LIRS ghosts included
+    bool full = cache->count >= cache->config.capacity;
+    if (full && cache->config.admission && !admitToCache(cache, identifier)) {
         return;
     }
 
-    int identifier = msg->identifier;
-    int hashIndex = identifier % hashTableSize;
+    if (cache->config.repStrategy == REP_ARC) {
+        arcPrepare(cache, identifier);
+    } else if (cache->config.repStrategy == REP_LIRS) {
+        lirsPrepare(cache, identifier);
+    }
 
-    CacheHashEntry *newCacheEntry = (CacheHashEntry*)malloc(sizeof(CacheHashEntry));
+    //If cache is full, execute replacement strategy, which gives a slot of the slab back
+    if (full) {
+        if(cache->config.repStrategy == REP_LRU) {
+            lruReplacement(cache);
+        } else if(cache->config.repStrategy == REP_RANDOM) {
+            randomReplacement(cache);
+        } else if(cache->config.repStrategy == REP_CLOCK) {
+            clockReplacement(cache);
+        } else if(cache->config.repStrategy == REP_LFU) {
+            lfuReplacement(cache);
+        } else if(cache->config.repStrategy == REP_ARC) {
+            arcReplacement(cache);
+        } else if(cache->config.repStrategy == REP_SLRU) {
+            slruReplacement(cache);
+        } else if(cache->config.repStrategy == REP_LIRS) {
+            lirsReplacement(cache);
+        }
+    }
+
+    CacheHashEntry *newCacheEntry = slabAlloc(&cache->slab);
     if (newCacheEntry == NULL) {
-        fprintf(stderr, "Error: Memory allocation failed for CacheHashEntry.\n");
+        fprintf(stderr, "Error: No free slot in the cache for message ID：%d.\n", identifier);
         return;
     }
 
-    LRUNode *newNode = (LRUNode*)malloc(sizeof(LRUNode));
-    if (newCacheEntry == NULL || newNode == NULL) {
-        free(newCacheEntry);
-        free(newNode);
+    if (packPayload(SLAB_PAYLOAD(&cache->slab, newCacheEntry), msg) != 0) {
+        slabFree(&cache->slab, newCacheEntry);
         return;
     }
-
     newCacheEntry->key = identifier;
-    newCacheEntry->messageWithStatus = (MessageWithStatus){ .message = *msg, .hitStatus = 3 };
     newCacheEntry->time_search = current_timestamp_ms();
-    newCacheEntry->lrNode = newNode;
+    newCacheEntry->expiresAt = cache->config.deliveredTtl > 0 && msg->delivered
+                               ? newCacheEntry->time_search + cache->config.deliveredTtl : 0;
+    newCacheEntry->lruNode = (LRUNode){ NULL, NULL };
     newCacheEntry->next = NULL;
+    newCacheEntry->pprev = NULL;
+    newCacheEntry->referenced = false;
 
-    newNode->key = identifier;
-    newNode->prev = NULL;
-    newNode->next = NULL;
+    if (indexInsert(cache, newCacheEntry) != 0) {
+        releaseEntry(cache, newCacheEntry);
+        return;
+    }
+    residentAdd(cache, newCacheEntry);
+    // CLOCK keeps no list, its order is the sweep of the hand
+    if (cache->config.repStrategy == REP_LFU) {
+        lfuInsert(cache, newCacheEntry);
+    } else if (cache->config.repStrategy == REP_ARC) {
+        arcInsert(cache, newCacheEntry);
+    } else if (cache->config.repStrategy == REP_SLRU) {
+        newCacheEntry->segment = SLRU_PROBATION;
+        addNodeToLRUHead(&cache->slruProbation, &newCacheEntry->lruNode);
+    } else if (cache->config.repStrategy == REP_LIRS) {
+        lirsInsert(cache, newCacheEntry);
+    } else if (cache->config.repStrategy != REP_CLOCK) {
+        addNodeToLRUHead(&cache->lru, &newCacheEntry->lruNode);
+    }
+    printf("message ID：%d is added to cache\n", msg->identifier);
+}
 
-    //If cache is full, execute replacement strategy
-    if (*cacheCount >= CACHE_SIZE) {
-        if(repStrategy == 0) {
-            lruReplacement(cacheHashTable, hashTableSize, lruCache, cacheCount);
-        } else if(repStrategy == 1) {
-            randomReplacement(cacheHashTable, hashTableSize, lruCache, cacheCount);
-        }
+/**
+  * Store messages in the cache and replace entries based on policy when the cache is full. At the same time, the message is saved to disk.
+  * Storing a message again (e.g. with delivered set) replaces the cached copy and the record on disk.
+  *
+  * Parameters:
+  * - msg: Pointer to the Message structure, indicating the message to be stored.
+  * - cache: Pointer to Cache structure, its configuration gives the capacity, the replacement strategy and the admission.
+  */
+void store_msg(const Message* msg, Cache *cache) {
+    if (msg == NULL) {
+        return;
+    }
+    if (cache->config.admission) {
+        sketchRecord(&cache->sketch, msg->identifier);
+    }
+    //A message stored again replaces its cached copy
+    CacheHashEntry *cached = indexFind(cache, msg->identifier);
+    if (cached != NULL) {
+        removeFromPolicy(cache, cached);
+        evictEntry(cache, cached);
     }
+    cacheMessage(msg, cache);
 
-    newCacheEntry->next = cacheHashTable[hashIndex];
-    cacheHashTable[hashIndex] = newCacheEntry;
-    (*cacheCount)++;
-    addNodeToLRUHead(lruCache, newNode);
-    printf("message ID：%d is added to cache\n", msg->identifier);
+    // Write the message to disk, the index tells whether the message already exists on the disk
+    // unchanged; a changed one gets a new record and its old record is left for compaction
+    DiskStore *store = messageStore();
+    if (store == NULL) {
+        fprintf(stderr, "Error: Unable to open the message store.\n");
+        return;
+    }
+    if (diskStoreAppend(store, msg) == 1) {
+        printf("message ID：%d is added to the disk\n", msg->identifier);
+    }
+}
 
-    // Write the message to disk, you need to check whether the message already exists on the disk
-    FILE* readFile = fopen("./messages.txt", "r");
-    if (readFile != NULL) {
-        char line[1024];
-        bool exists = false;
-        while (fgets(line, sizeof(line), readFile) != NULL) {
-            int existingID;
-            if (sscanf(line, "%d", &existingID) == 1 && existingID == identifier) {
-                exists = true;
-                break;
-            }
-        }
-        fclose(readFile);
-
-        // 如果消息不存在，则将其写入磁盘
-        if (!exists) {
-            FILE* writeFile = fopen("./messages.txt", "a");
-            if (writeFile != NULL) {
-                fprintf(writeFile, "%d %ld %s %s %s %d\n", msg->identifier, msg->time_sent,
-                        msg->sender, msg->receiver, msg->content, msg->delivered);
-                printf("message ID：%d is added to the disk\n", msg->identifier);
-                fclose(writeFile);
-            } else {
-                fprintf(stderr, "Error: Unable to open file messages.txt for writing.\n");
-            }
-        }
+/**
+  * Look a message up in the cache. A hit moves it to the head of the LRU list, sets its CLOCK reference bit
+  * raises its LFU frequency, moves it to ARC's T2, promotes it in SLRU or moves it up the LIRS stack.
+  * A delivered message found past its time to live is dropped and reported as not cached.
+  *
+  * Parameters:
+  * - identifier: integer, identifier of the message.
+  * - cache: Pointer to Cache structure.
+  *
+  * return value:
+  * - MessageWithStatus*: Pointer to the message unpacked into cache->hitResult with status 1, or NULL if it is not in the cache.
+  */
+static MessageWithStatus* findInCache(int identifier, Cache *cache) {
+    CacheHashEntry *current = indexFind(cache, identifier);
+    if (current == NULL) {
+        return NULL;
+    }
+    time_t now = current_timestamp_ms();
+    if (isExpired(current, now)) {
+        //Lazy expiry: the message is read from disk again, as if it had been evicted
+        expireEntry(cache, current);
+        return NULL;
+    }
+    current->time_search = now;
+    if (cache->config.repStrategy == REP_CLOCK) {
+        current->referenced = true;    //a single store, no list to update
+    } else if (cache->config.repStrategy == REP_LFU) {
+        lfuHit(cache, current);
+    } else if (cache->config.repStrategy == REP_ARC) {
+        arcHit(cache, current);
+    } else if (cache->config.repStrategy == REP_SLRU) {
+        slruHit(cache, current);
+    } else if (cache->config.repStrategy == REP_LIRS) {
+        lirsHit(cache, current);
     } else {
-        fprintf(stderr, "Error: Unable to open file messages.txt for reading.\n");
+        moveToHead(&cache->lru, &current->lruNode);
+    }
+    unpackPayload(identifier, SLAB_PAYLOAD(&cache->slab, current), &cache->hitResult.message);
+    cache->hitResult.hitStatus = 1;
+
+    printf("Find message with ID：%d in cache\n", identifier);
+    return &cache->hitResult;
+}
+
+/**
+  * Load a message read from disk into the cache (no cache: only return it).
+  *
+  * return value:
+  * - MessageWithStatus*: Newly allocated copy of the message with status 2.
+  */
+static MessageWithStatus* loadFromDisk(const Message *msg, Cache *cache) {
+    printf("Not found in cache, message with ID ：%d was found in disk\n", msg->identifier);
+    //Load data from disk to cache, it is already on disk
+    if (cache != NULL) {
+        cacheMessage(msg, cache);
+    }
+
+    MessageWithStatus* msgStatus = (MessageWithStatus*)malloc(sizeof(MessageWithStatus));
+    if (msgStatus == NULL) {
+        fprintf(stderr,"Memory allocation failed.\n");
+        exit(1);
+    }
+    *msgStatus = (MessageWithStatus){ .message = *msg, .hitStatus = 2 };
+    return msgStatus;
+}
+
+/**
+  * Result for a message that is neither in the cache nor on disk.
+  *
+  * return value:
+  * - MessageWithStatus*: Newly allocated structure with status 3, or NULL if memory allocation failed.
+  */
+static MessageWithStatus* notFound() {
+    MessageWithStatus* newMsgStatus = (MessageWithStatus*)malloc(sizeof(MessageWithStatus));
+    if (newMsgStatus == NULL) {
+        fprintf(stderr,"Memory allocation failed.\n");
+        return NULL;
+    }
+    *newMsgStatus = (MessageWithStatus){ .hitStatus = 3 };
+    return newMsgStatus;
+}
+
+/**
+  * Look a message up in the cache, then on disk, without counting the access for the admission.
+  */
+static MessageWithStatus* lookupMessage(int identifier, Cache *cache) {
+    //Find message in cache first
+    MessageWithStatus *cached = findInCache(identifier, cache);
+    if (cached != NULL) {
+        return cached;
     }
+    //Then search message in the disk: the index gives the record position, so one seek and one read
+    DiskStore *store = messageStore();
+    Message msg;
+    if (store != NULL && diskStoreRead(store, identifier, &msg) == 1) {
+        return loadFromDisk(&msg, cache);
+    }
+    return notFound();
 }
 
 /**
@@ -327,70 +1588,140 @@ void store_msg(const Message* msg, CacheHashEntry *cacheHashTable[], int hashTab
   *
   * Parameters:
   * - identifier: integer, identifier of the message to be retrieved.
-  * - cacheHashTable[]: CacheHashEntry pointer array, pointing to the cache hash table.
-  * - hashTableSize: integer, indicating the size of the hash table.
-  * - lruCache: Pointer to LRUCache structure, used to maintain LRU information.
-  * - cacheCount: Pointer to the number of entries in the cache.
-  * - repStrategy: integer, indicating the replacement strategy used (0 means LRU, 1 means random).
+  * - cache: Pointer to Cache structure.
   *
   * return value:
   * - MessageWithStatus*: Pointer to a structure containing the retrieved message and its status. If the message is not found, a new structure with status 3 is returned.
+  *   A cache hit points into the cache and stays valid until the next call on the cache; the other results are newly allocated.
   */
-MessageWithStatus* retrieve_msg(int identifier, CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount, int repStrategy) {
-    int hashIndex = identifier % hashTableSize;
-    CacheHashEntry *current = cacheHashTable[hashIndex];
+MessageWithStatus* retrieve_msg(int identifier, Cache *cache) {
+    //Every retrieve counts for the admission, whether it hits or not
+    if (cache->config.admission) {
+        sketchRecord(&cache->sketch, identifier);
+    }
+    return lookupMessage(identifier, cache);
+}
 
-    //Find message in cache first
-    while (current != NULL) {
-        if (current->key == identifier) {
-            current->time_search = current_timestamp_ms();
-            current->messageWithStatus.hitStatus = 1;
-            moveToHead(lruCache, current->lrNode);
-
-            printf("Find message with ID：%d in cache\n", identifier);
-            return &current->messageWithStatus;
+/**
+  * Get a free slot for an asynchronous retrieve, setting up the io_uring on first use.
+  *
+  * return value:
+  * - PendingRetrieve*: Pointer to a free slot, or NULL if all ASYNC_QUEUE_DEPTH slots are in use.
+  */
+static PendingRetrieve* freeRetrieveSlot() {
+    if (!asyncIoReady) {
+        if (asyncIoInit(&asyncIo, ASYNC_QUEUE_DEPTH) != 0) {
+            return NULL;
         }
-        current = current->next;
-    }
-    //Then search message in the disk
-    FILE* file = fopen("messages.txt", "r");
-    if (file != NULL) {
-        Message msg;
-        char line[1000];
-        while (fgets(line, sizeof(line), file) != NULL) {
-            if (sscanf(line, "%d %ld %49s %49s %799s %d", &msg.identifier, &msg.time_sent, msg.sender, msg.receiver, msg.content, &msg.delivered) == 6) {
-                if (msg.identifier == identifier) {
-                    Message* retrieved_msg = create_msg(msg.identifier, msg.sender, msg.receiver, msg.content, msg.delivered, Context_limit);
-                    retrieved_msg->time_sent = msg.time_sent;
-                    fclose(file);
-
-                    printf("Not found in cache, message with ID ：%d was found in disk\n", identifier);
-                    //Load data from disk to cache
-                    store_msg(retrieved_msg, cacheHashTable, hashTableSize, lruCache, cacheCount, repStrategy);
-
-                    MessageWithStatus* msgStatus = (MessageWithStatus*)malloc(sizeof(MessageWithStatus));
-                    if (msgStatus == NULL) {
-                        fprintf(stderr,"Memory allocation failed.\n");
-                        exit(1);
-                    }
-                    *msgStatus = (MessageWithStatus){ .message = *retrieved_msg, .hitStatus = 2 };
-                    free(retrieved_msg);
-                    return msgStatus;
-                }
-            }
+        asyncIoReady = true;
+    }
+    for (int i = 0; i < ASYNC_QUEUE_DEPTH; i++) {
+        if (!pendingRetrieves[i].used) {
+            return &pendingRetrieves[i];
         }
-        fclose(file);
     }
-    // not found on disk
-    MessageWithStatus* newMsgStatus = (MessageWithStatus*)malloc(sizeof(MessageWithStatus));
-    if (newMsgStatus == NULL) {
-        fprintf(stderr,"Memory allocation failed.\n");
-        return NULL;
+    return NULL;
+}
+
+/**
+  * Retrieve a message without waiting for the disk. A cache hit, a message that is not on disk or one that
+  * is still in the write buffer is answered at once; otherwise the disk read is submitted (io_uring on Linux)
+  * and the callback runs from poll_retrieve once it has finished. The result passed to the callback is the one
+  * retrieve_msg would return. If too many reads are in flight, the message is retrieved synchronously.
+  *
+  * Parameters:
+  * - identifier: integer, identifier of the message.
+  * - cache: Pointer to Cache structure the message is loaded into.
+  * - callback: function called with the result.
+  * - context: passed to the callback.
+  *
+  * return value:
+  * - int: 1 if a disk read is in flight, 0 if the callback has already been called.
+  */
+int retrieve_msg_async(int identifier, Cache *cache, RetrieveCallback callback, void *context) {
+    if (cache->config.admission) {
+        sketchRecord(&cache->sketch, identifier);
+    }
+    MessageWithStatus *cached = findInCache(identifier, cache);
+    if (cached != NULL) {
+        callback(cached, context);
+        return 0;
     }
-    *newMsgStatus = (MessageWithStatus){ .hitStatus = 3 };
 
-    return newMsgStatus;
+    DiskStore *store = messageStore();
+    DiskSpan span;
+    int located = store != NULL ? diskStoreLocate(store, identifier, &span) : -1;
+    if (located == DISK_NOT_FOUND) {
+        callback(notFound(), context);
+        return 0;
+    }
+    PendingRetrieve *pending = located == DISK_LOCATED ? freeRetrieveSlot() : NULL;
+    unsigned char *buffer = pending != NULL ? (unsigned char*)malloc(span.length) : NULL;
+    if (buffer == NULL
+        || asyncIoRead(&asyncIo, span.fd, buffer, span.length, span.offset, (uint64_t)(pending - pendingRetrieves)) != 0) {
+        free(buffer);
+        callback(lookupMessage(identifier, cache), context);
+        return 0;
+    }
+
+    *pending = (PendingRetrieve){ .used = true, .identifier = identifier, .span = span, .buffer = buffer,
+                                  .callback = callback, .context = context, .cache = cache };
+    return 1;
+}
+
+/**
+  * Finish an asynchronous retrieve whose disk read has completed and call its callback.
+  *
+  * Parameters:
+  * - pending: Pointer to the PendingRetrieve slot.
+  * - result: byte count of the read, or -errno.
+  */
+static void completeRetrieve(PendingRetrieve *pending, int result) {
+    PendingRetrieve done = *pending;
+    pending->used = false;
 
+    Message msg;
+    int found = result == done.span.length
+                ? segmentScanSpan(done.buffer, (size_t)result, done.span.compressed, done.identifier, &msg) : -1;
+    free(done.buffer);
+    if (done.cache == NULL) {
+        //The cache was destroyed while the read was in flight
+        done.callback(found == 1 ? loadFromDisk(&msg, NULL) : notFound(), done.context);
+        return;
+    }
+    MessageWithStatus *cached = findInCache(done.identifier, done.cache);
+    if (cached != NULL) {
+        //Another retrieve of the same message has loaded it meanwhile
+        done.callback(cached, done.context);
+        return;
+    }
+    if (found != 1) {
+        //A Bloom filter false positive in a sealed segment, or a failed read: look the message up again
+        done.callback(lookupMessage(done.identifier, done.cache), done.context);
+        return;
+    }
+    done.callback(loadFromDisk(&msg, done.cache), done.context);
+}
+
+/**
+  * Run the callbacks of the asynchronous retrieves whose disk reads have finished.
+  *
+  * Parameters:
+  * - minComplete: integer, wait until at least this many have finished (0 does not wait).
+  *
+  * return value:
+  * - int: Number of callbacks run, or -1 if waiting failed.
+  */
+int poll_retrieve(int minComplete) {
+    if (!asyncIoReady) {
+        return 0;
+    }
+    AsyncCompletion completions[ASYNC_QUEUE_DEPTH];
+    int count = asyncIoReap(&asyncIo, completions, ASYNC_QUEUE_DEPTH, minComplete);
+    for (int i = 0; i < count; i++) {
+        completeRetrieve(&pendingRetrieves[completions[i].userData], completions[i].result);
+    }
+    return count;
 }
 
 /**
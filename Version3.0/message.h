@@ -4,11 +4,15 @@
 #define P1_MESSAGE_H
 #include <sys/time.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-//Define cache size and message size
+//Define the default cache capacity and message size
 #define CACHE_SIZE 16
 #define Message_limit 1024
 #define Context_limit Message_limit-224
+//Text bytes a cached message holds without a separate allocation, sized so its CachePayload fills a 64-byte cache line
+#define CACHE_INLINE_PAYLOAD 40
 
 typedef struct Message {
     int identifier;
@@ -25,26 +29,243 @@ typedef struct MessageWithStatus{
 } MessageWithStatus;
 
 
+//LRU links, embedded in the cache entry they order (see LRU_ENTRY)
 typedef struct LRUNode {
-    int key;
     struct LRUNode *prev;
     struct LRUNode *next;
 } LRUNode;
 
+/*
+ * The hot part of a cached message: everything a lookup, an LRU update or an eviction touches, 64 bytes.
+ * The entries of a cache sit in one dense array (EntrySlab.slots); the rest of each message is kept apart
+ * in a CachePayload of the same slot (see SLAB_PAYLOAD).
+ */
 typedef struct CacheHashEntry {
-    int key; // Message identifier%hashsize
-    MessageWithStatus messageWithStatus;
-    LRUNode *lrNode;
+    int key; // Message identifier
+    int residentIndex;             //position in Cache.resident
     time_t time_search;
+    LRUNode lruNode;
     struct CacheHashEntry *next;
+    struct CacheHashEntry **pprev; //the pointer to this entry in its chain, so it can be unlinked without a lookup
+    bool referenced;               //CLOCK reference bit, set on a hit
+    unsigned char frequency;       //LFU access count, as of lfuEpoch
+    unsigned char segment;         //list of the entry in segmented strategies (ARC_T1, ...)
+    int lfuEpoch;                  //Cache.lfuEpoch when frequency was last updated
+    time_t expiresAt;              //time (ms) at which a delivered message leaves the cache, 0 for never
 } CacheHashEntry;
 
+/*
+ * The cold part of a cached message, one 64-byte cache line. Only the fixed fields of the message are stored
+ * inline; sender, receiver and content are packed one after the other (each ending with '\0') into text when
+ * they fit, or into an exactly sized heap block otherwise, so a message costs about its actual text rather
+ * than a full Message.
+ */
+typedef struct CachePayload {
+    time_t time_sent;
+    int delivered;
+    unsigned short senderLength;     //string lengths without the terminating '\0'
+    unsigned short receiverLength;
+    unsigned short contentLength;
+    union {
+        char text[CACHE_INLINE_PAYLOAD];
+        char *heapText;              //used when the text is longer than CACHE_INLINE_PAYLOAD
+    };
+} CachePayload;
+
+//The cache entry that embeds an LRU node
+#define LRU_ENTRY(node) ((CacheHashEntry*)((char*)(node) - offsetof(CacheHashEntry, lruNode)))
+
+/*
+ * Chained hash table of the cache entries. It doubles when the load factor passes CACHE_HASH_MAX_LOAD and halves
+ * when it drops below CACHE_HASH_MIN_LOAD. Resizing is incremental: while rehashIndex >= 0 the entries of
+ * buckets[0] are moved to buckets[1] a few buckets per operation, and lookups check both tables.
+ */
+typedef struct CacheHashTable {
+    CacheHashEntry **buckets[2];
+    int size[2];         //power of two
+    int used;            //number of entries in both tables
+    int rehashIndex;     //next bucket of buckets[0] to move, -1 when not resizing
+} CacheHashTable;
+
 
 typedef struct {
     LRUNode *head;
     LRUNode *tail;
 } LRUCache;
 
+/*
+ * Open-addressing (Swiss table) index of the cache entries. Slots are grouped by SWISS_GROUP_WIDTH; every slot has
+ * a control byte holding SWISS_EMPTY, SWISS_DELETED or the low 7 bits of the hash of its key, and a lookup compares
+ * the key fingerprint against a whole group of control bytes at once. Keys are stored inline next to the control
+ * bytes, so a lookup only touches the entry it returns.
+ */
+typedef struct SwissTable {
+    signed char *ctrl;
+    int *keys;
+    CacheHashEntry **values;
+    int capacity;        //number of slots, a power of two and a multiple of the group width
+    int used;            //full slots
+    int deleted;         //slots marked SWISS_DELETED
+} SwissTable;
+
+/*
+ * Preallocated storage for the entries of a cache, one slot per message of its capacity, as two parallel arrays:
+ * the hot entries and their cold payloads. Slots that were never handed out are taken in order (nextUnused);
+ * released slots go to a free list linked through CacheHashEntry.next.
+ */
+typedef struct EntrySlab {
+    CacheHashEntry *slots;
+    CachePayload *payloads;      //payloads[i] belongs to slots[i]
+    size_t bytes;                //size of the mapping
+    int capacity;
+    int nextUnused;
+    CacheHashEntry *freeList;
+} EntrySlab;
+
+//Hash index of a cache: a chained table that resizes incrementally, or a Swiss table
+typedef enum CacheIndexType {
+    CACHE_INDEX_CHAINED = 0,
+    CACHE_INDEX_SWISS = 1
+} CacheIndexType;
+
+//Replacement strategies of a cache (CacheConfig.repStrategy)
+#define REP_LRU 0
+#define REP_RANDOM 1
+#define REP_CLOCK 2
+#define REP_LFU 3
+#define REP_ARC 4
+#define REP_SLRU 5
+#define REP_LIRS 6
+//Share of an SLRU cache kept for the protected segment when CacheConfig.slruProtectedPercent is 0
+#define SLRU_DEFAULT_PROTECTED_PERCENT 80
+//LFU counts accesses up to this frequency, one list per frequency
+#define LFU_MAX_FREQUENCY 255
+
+//Lists of ARC: resident entries seen once (T1) or more (T2) lately, ghosts evicted from T1 (B1) or T2 (B2)
+#define ARC_T1 1
+#define ARC_T2 2
+#define ARC_B1 3
+#define ARC_B2 4
+
+/*
+ * State of the ARC replacement. The resident entries are in T1 or T2, the keys recently evicted from them are
+ * remembered in the ghost lists B1 and B2, and target (the size T1 should have) grows on a B1 ghost hit and
+ * shrinks on a B2 ghost hit. Ghosts are CacheHashEntry structures without a payload, taken from a pool of
+ * capacity nodes and indexed by their own hash table.
+ */
+typedef struct ArcState {
+    LRUCache t1, t2, b1, b2;
+    int t1Size, t2Size, b1Size, b2Size;
+    int target;
+    int incoming;                //list the message being stored goes to, ARC_T1 or ARC_T2
+    bool incomingFromB2;         //the message being stored was a B2 ghost
+    bool dropVictim;             //T1 and B1 hold a full cache: the next victim leaves no ghost
+    CacheHashTable ghosts;
+    CacheHashEntry *ghostPool;
+    CacheHashEntry *freeGhosts;
+} ArcState;
+
+//Segments of SLRU: entries seen once wait in probation, a second hit promotes them to protected
+#define SLRU_PROBATION 1
+#define SLRU_PROTECTED 2
+
+//States of a LIRS entry: LIR, resident HIR out of or in the stack, and a non-resident HIR ghost in the stack
+#define LIRS_LIR 1
+#define LIRS_HIR 2
+#define LIRS_HIR_STACKED 3
+#define LIRS_GHOST 4
+//Share of a LIRS cache for resident HIR entries when CacheConfig.lirsHirPercent is 0
+#define LIRS_DEFAULT_HIR_PERCENT 1
+
+/*
+ * State of the LIRS replacement. The stack S orders LIR entries, HIR entries and ghosts by recency and is
+ * pruned so an LIR entry is always at its bottom; the queue Q holds the resident HIR entries, and the next
+ * victim is at its tail. Resident entries are linked into S by their lruNode and into Q by the node of their
+ * slab slot in queueNodes. Ghosts are CacheHashEntry structures without a payload, taken from a pool of
+ * capacity nodes and indexed by their own hash table.
+ */
+typedef struct LirsState {
+    LRUCache stack;
+    LRUCache queue;
+    LRUNode *queueNodes;         //queueNodes[i] links slab slot i into Q
+    int lirCount;
+    int lirLimit;                //LIR entries kept, the rest of the capacity holds resident HIR entries
+    bool incomingLir;            //the message being stored was a ghost, it becomes LIR
+    CacheHashTable ghosts;
+    CacheHashEntry *ghostPool;
+    CacheHashEntry *freeGhosts;
+} LirsState;
+
+//Rows of the TinyLFU frequency sketch, its counters per row (one per cached message, within these bounds),
+//the largest value of a 4-bit counter, and the accesses per counter between two agings of the sketch
+#define SKETCH_DEPTH 4
+#define SKETCH_MIN_WIDTH 64
+#define SKETCH_MAX_WIDTH 4096
+#define SKETCH_MAX_COUNT 15
+#define SKETCH_SAMPLE_FACTOR 10
+
+/*
+ * Count-min sketch of the recent accesses of messages, used by the TinyLFU admission (CacheConfig.admission).
+ * Each of the SKETCH_DEPTH rows has width 4-bit counters, two per byte; an access raises one counter per row and
+ * the estimate of a key is the smallest of its counters. The first access of a key only sets its bits in the
+ * doorkeeper, a small Bloom filter, so the many messages read once do not fill the counters. After sampleSize
+ * accesses all counters are halved and the doorkeeper is cleared. At most 8 KB of counters and 1 KB of doorkeeper.
+ */
+typedef struct FrequencySketch {
+    unsigned char *counters;     //SKETCH_DEPTH rows of width / 2 bytes
+    uint64_t *doorkeeper;
+    int width;                   //counters per row, a power of two
+    int doorkeeperBits;          //a power of two
+    int additions;               //accesses counted since the last aging
+    int sampleSize;
+} FrequencySketch;
+
+//Cached messages the expiry sweeper looks at per stored message
+#define CACHE_EXPIRE_STEP 8
+
+//Runtime settings of a cache, passed to createCache
+typedef struct CacheConfig {
+    int capacity;         //messages held before the replacement strategy evicts one
+    int initialBuckets;   //sizing hint for the hash table, e.g. the expected number of messages
+    int repStrategy;      //REP_LRU, REP_RANDOM, REP_CLOCK, REP_LFU, REP_ARC, REP_SLRU or REP_LIRS
+    CacheIndexType indexType;
+    bool hugePages;       //back the entry slab with transparent huge pages where the system supports them
+    unsigned int seed;    //seed of the random replacement, 0 seeds it from the clock
+    int lfuAgingPeriod;   //LFU: accesses between two halvings of all frequencies, 0 never ages them
+    int slruProtectedPercent;    //SLRU: share of the capacity for the protected segment, 0 for the default
+    int lirsHirPercent;   //LIRS: share of the capacity for resident HIR entries, 0 for the default
+    time_t deliveredTtl;  //time (ms) a delivered message stays cached, 0 keeps it until it is evicted
+    bool admission;       //TinyLFU: a message only replaces the victim of a full cache if it was accessed more often
+} CacheConfig;
+
+typedef struct Cache {
+    CacheConfig config;
+    CacheHashTable table;    //used with CACHE_INDEX_CHAINED
+    SwissTable swiss;        //used with CACHE_INDEX_SWISS
+    EntrySlab slab;          //storage of the cache entries
+    LRUCache lru;
+    CacheHashEntry **resident;    //the cached entries, densely packed in count slots
+    int count;            //messages in the cache
+    uint64_t randomState; //xorshift state of the random replacement
+    int clockHand;        //next index of resident the CLOCK replacement looks at
+    int expireCursor;     //next index of resident the expiry sweeper looks at
+    LRUCache *lfuBuckets;     //LFU: entries of each frequency 1..LFU_MAX_FREQUENCY, most recent first
+    int lfuMinFrequency;      //LFU: lowest frequency that may have entries
+    int lfuEpoch;             //LFU: number of agings so far
+    int lfuAccesses;          //LFU: accesses since the last aging
+    ArcState *arc;            //ARC: lists and ghosts
+    LRUCache slruProbation;   //SLRU: entries hit at most once since they were stored
+    LRUCache slruProtected;   //SLRU: entries hit again while in probation
+    int slruProtectedCount;
+    int slruProtectedLimit;
+    LirsState *lirs;          //LIRS: stack, queue and ghosts
+    FrequencySketch sketch;   //TinyLFU admission, counters is NULL when CacheConfig.admission is off
+    MessageWithStatus hitResult;    //a cache hit is unpacked here, valid until the next call on the cache
+} Cache;
+
+//Called with the result of retrieve_msg_async, which is owned like the result of retrieve_msg
+typedef void (*RetrieveCallback)(MessageWithStatus *result, void *context);
+
 
 void addNodeToLRUHead(LRUCache *lruCache, LRUNode *node);
 void removeNodeFromLRU(LRUCache *lruCache, LRUNode *node);
@@ -53,10 +274,23 @@ void moveToHead(LRUCache *lruCache, LRUNode *node);
 long long current_timestamp_ms();
 char* generateRandomNumberString();
 
-int randomReplacement(CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount);
-int lruReplacement(CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount);
+Cache* createCache(const CacheConfig *config);
+void destroyCache(Cache *cache);
+
+int randomReplacement(Cache *cache);
+int lruReplacement(Cache *cache);
+int clockReplacement(Cache *cache);
+int lfuReplacement(Cache *cache);
+int arcReplacement(Cache *cache);
+int slruReplacement(Cache *cache);
+int lirsReplacement(Cache *cache);
+int expireCache(Cache *cache, int maxChecked);
 
 Message* create_msg(int unique_id, const char* sender, const char* receiver, const char* content, int delFlag,int limitsize);
-void store_msg(const Message* msg, CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount, int repStrategy);
-MessageWithStatus* retrieve_msg(int identifier, CacheHashEntry *cacheHashTable[], int hashTableSize, LRUCache *lruCache, int *cacheCount, int repStrategy);
+void store_msg(const Message* msg, Cache *cache);
+void closeMessageStore();
+int compactMessageStore();
+MessageWithStatus* retrieve_msg(int identifier, Cache *cache);
+int retrieve_msg_async(int identifier, Cache *cache, RetrieveCallback callback, void *context);
+int poll_retrieve(int minComplete);
 #endif //P1_MESSAGE_H
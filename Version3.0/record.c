@@ -0,0 +1,220 @@
+/*
+* record.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "record.h"
+#include <string.h>
+#include <unistd.h>
+
+//Byte offsets of the fields inside a record
+#define OFFSET_LENGTH 0
+#define OFFSET_IDENTIFIER 4
+#define OFFSET_TIME_SENT 8
+#define OFFSET_DELIVERED 16
+#define OFFSET_SENDER_LENGTH 20
+#define OFFSET_RECEIVER_LENGTH 22
+#define OFFSET_CONTENT_LENGTH 24
+
+/**
+  * Write the versioned header at the start of an empty message file.
+  *
+  * Parameters:
+  * - file: FILE pointer positioned at the start of the file.
+  * - fileId: id of this file, a rewritten file (e.g. after compaction) gets a new one.
+  *
+  * return value:
+  * - int: 0 on success, -1 on write failure.
+  */
+int writeFileHeader(FILE *file, uint32_t fileId) {
+    unsigned char header[FILE_HEADER_SIZE] = {0};
+    int32_t version = FILE_VERSION;
+    memcpy(header, FILE_MAGIC, strlen(FILE_MAGIC));
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &fileId, sizeof(fileId));
+    return fwrite(header, sizeof(header), 1, file) == 1 ? 0 : -1;
+}
+
+/**
+  * Check the header of a message file.
+  *
+  * Parameters:
+  * - header: bytes read from the start of the file.
+  * - available: number of bytes in header.
+  *
+  * return value:
+  * - int: 0 if the file is a message file of the supported version, -1 otherwise.
+  */
+int checkFileHeader(const unsigned char *header, size_t available) {
+    int32_t version;
+    if (available < FILE_HEADER_SIZE || memcmp(header, FILE_MAGIC, strlen(FILE_MAGIC)) != 0) {
+        return -1;
+    }
+    memcpy(&version, header + 8, sizeof(version));
+    return version == FILE_VERSION ? 0 : -1;
+}
+
+/**
+  * Read the id of a message file from its header.
+  *
+  * Parameters:
+  * - header: FILE_HEADER_SIZE bytes read from the start of the file.
+  *
+  * return value:
+  * - uint32_t: Id of the file, 0 for files written before ids were introduced.
+  */
+uint32_t fileHeaderId(const unsigned char *header) {
+    uint32_t fileId;
+    memcpy(&fileId, header + 12, sizeof(fileId));
+    return fileId;
+}
+
+/**
+  * Generate an id for a new message file.
+  *
+  * return value:
+  * - uint32_t: Non-zero id built from the current time and the process id.
+  */
+uint32_t generateFileId() {
+    uint32_t fileId = (uint32_t)current_timestamp_ms() ^ ((uint32_t)getpid() << 16);
+    return fileId != 0 ? fileId : 1;
+}
+
+/**
+  * Read the length prefix of a record.
+  *
+  * Parameters:
+  * - buffer: start of the record, at least 4 bytes.
+  *
+  * return value:
+  * - uint32_t: Length of the whole record in bytes.
+  */
+uint32_t recordLength(const unsigned char *buffer) {
+    uint32_t length;
+    memcpy(&length, buffer + OFFSET_LENGTH, sizeof(length));
+    return length;
+}
+
+/**
+  * Read the identifier of a record without decoding the rest of it.
+  *
+  * Parameters:
+  * - buffer: start of the record, at least RECORD_HEADER_SIZE bytes.
+  *
+  * return value:
+  * - int: Message identifier stored in the record.
+  */
+int recordIdentifier(const unsigned char *buffer) {
+    int32_t identifier;
+    memcpy(&identifier, buffer + OFFSET_IDENTIFIER, sizeof(identifier));
+    return identifier;
+}
+
+/**
+  * Read the send time of a record without decoding the rest of it.
+  *
+  * Parameters:
+  * - buffer: start of the record, at least RECORD_HEADER_SIZE bytes.
+  *
+  * return value:
+  * - int64_t: time_sent stored in the record.
+  */
+int64_t recordTimeSent(const unsigned char *buffer) {
+    int64_t timeSent;
+    memcpy(&timeSent, buffer + OFFSET_TIME_SENT, sizeof(timeSent));
+    return timeSent;
+}
+
+/**
+  * Encode a message as a binary record. A string field without a terminator is cut to one byte less than
+  * its field, the longest string decodeRecord accepts.
+  *
+  * Parameters:
+  * - msg: Pointer to the Message structure to encode.
+  * - buffer: output buffer.
+  * - bufferSize: size of the output buffer, RECORD_MAX_SIZE is always enough.
+  *
+  * return value:
+  * - int: Length of the record in bytes, or -1 if the buffer is too small.
+  */
+int encodeRecord(const Message *msg, unsigned char *buffer, size_t bufferSize) {
+    uint16_t senderLength = (uint16_t)strnlen(msg->sender, sizeof(msg->sender) - 1);
+    uint16_t receiverLength = (uint16_t)strnlen(msg->receiver, sizeof(msg->receiver) - 1);
+    uint16_t contentLength = (uint16_t)strnlen(msg->content, sizeof(msg->content) - 1);
+    uint32_t length = RECORD_HEADER_SIZE + senderLength + receiverLength + contentLength;
+    if (length > bufferSize) {
+        return -1;
+    }
+
+    int32_t identifier = msg->identifier;
+    int64_t timeSent = msg->time_sent;
+    int32_t delivered = msg->delivered;
+    memcpy(buffer + OFFSET_LENGTH, &length, sizeof(length));
+    memcpy(buffer + OFFSET_IDENTIFIER, &identifier, sizeof(identifier));
+    memcpy(buffer + OFFSET_TIME_SENT, &timeSent, sizeof(timeSent));
+    memcpy(buffer + OFFSET_DELIVERED, &delivered, sizeof(delivered));
+    memcpy(buffer + OFFSET_SENDER_LENGTH, &senderLength, sizeof(senderLength));
+    memcpy(buffer + OFFSET_RECEIVER_LENGTH, &receiverLength, sizeof(receiverLength));
+    memcpy(buffer + OFFSET_CONTENT_LENGTH, &contentLength, sizeof(contentLength));
+
+    unsigned char *tail = buffer + RECORD_HEADER_SIZE;
+    memcpy(tail, msg->sender, senderLength);
+    tail += senderLength;
+    memcpy(tail, msg->receiver, receiverLength);
+    tail += receiverLength;
+    memcpy(tail, msg->content, contentLength);
+    return (int)length;
+}
+
+/**
+  * Decode a binary record into a message.
+  *
+  * Parameters:
+  * - buffer: start of the record.
+  * - available: number of readable bytes from buffer.
+  * - msg: Pointer to the Message structure that receives the decoded fields.
+  *
+  * return value:
+  * - int: Length of the record in bytes, or -1 if the record is truncated or corrupt.
+  */
+int decodeRecord(const unsigned char *buffer, size_t available, Message *msg) {
+    if (available < RECORD_HEADER_SIZE) {
+        return -1;
+    }
+    uint32_t length = recordLength(buffer);
+    int32_t identifier;
+    int64_t timeSent;
+    int32_t delivered;
+    uint16_t senderLength, receiverLength, contentLength;
+    memcpy(&identifier, buffer + OFFSET_IDENTIFIER, sizeof(identifier));
+    memcpy(&timeSent, buffer + OFFSET_TIME_SENT, sizeof(timeSent));
+    memcpy(&delivered, buffer + OFFSET_DELIVERED, sizeof(delivered));
+    memcpy(&senderLength, buffer + OFFSET_SENDER_LENGTH, sizeof(senderLength));
+    memcpy(&receiverLength, buffer + OFFSET_RECEIVER_LENGTH, sizeof(receiverLength));
+    memcpy(&contentLength, buffer + OFFSET_CONTENT_LENGTH, sizeof(contentLength));
+
+    if (length > available
+        || length != (uint32_t)RECORD_HEADER_SIZE + senderLength + receiverLength + contentLength
+        || senderLength >= sizeof(msg->sender)
+        || receiverLength >= sizeof(msg->receiver)
+        || contentLength >= sizeof(msg->content)) {
+        return -1;
+    }
+
+    msg->identifier = identifier;
+    msg->time_sent = (time_t)timeSent;
+    msg->delivered = delivered;
+    const unsigned char *tail = buffer + RECORD_HEADER_SIZE;
+    memcpy(msg->sender, tail, senderLength);
+    msg->sender[senderLength] = '\0';
+    tail += senderLength;
+    memcpy(msg->receiver, tail, receiverLength);
+    msg->receiver[receiverLength] = '\0';
+    tail += receiverLength;
+    memcpy(msg->content, tail, contentLength);
+    msg->content[contentLength] = '\0';
+    return (int)length;
+}
@@ -0,0 +1,44 @@
+/*
+* record.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_RECORD_H
+#define P1_RECORD_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "message.h"
+
+//Define the header of the binary message file: magic, version and an id that ties the index file to this file
+#define FILE_MAGIC "P1MSG"
+#define FILE_VERSION 1
+#define FILE_HEADER_SIZE 16
+
+/*
+ * Layout of one record (host byte order, no padding):
+ *   uint32 length          whole record in bytes, header included
+ *   int32  identifier
+ *   int64  time_sent
+ *   int32  delivered
+ *   uint16 sender length
+ *   uint16 receiver length
+ *   uint16 content length
+ *   sender, receiver and content bytes, not NUL terminated
+ */
+#define RECORD_HEADER_SIZE 26
+#define RECORD_MAX_SIZE (RECORD_HEADER_SIZE + sizeof(((Message*)0)->sender) + sizeof(((Message*)0)->receiver) + sizeof(((Message*)0)->content))
+
+int writeFileHeader(FILE *file, uint32_t fileId);
+int checkFileHeader(const unsigned char *header, size_t available);
+uint32_t fileHeaderId(const unsigned char *header);
+uint32_t generateFileId();
+uint32_t recordLength(const unsigned char *buffer);
+int recordIdentifier(const unsigned char *buffer);
+int64_t recordTimeSent(const unsigned char *buffer);
+int encodeRecord(const Message *msg, unsigned char *buffer, size_t bufferSize);
+int decodeRecord(const unsigned char *buffer, size_t available, Message *msg);
+#endif //P1_RECORD_H
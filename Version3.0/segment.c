@@ -0,0 +1,493 @@
+/*
+* segment.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "segment.h"
+#include "record.h"
+#include "lz.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Largest uncompressed block: a block is closed once it reaches SEGMENT_BLOCK_SIZE
+#define BLOCK_MAX_SIZE (SEGMENT_BLOCK_SIZE + RECORD_MAX_SIZE)
+
+/**
+  * Open a sealed segment: map it and validate its footer.
+  *
+  * Parameters:
+  * - segment: Pointer to Segment structure to initialize.
+  * - path: string, path of the segment file.
+  * - sequence: integer, sequence number of the segment.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the file cannot be mapped or is not a sealed segment.
+  */
+int segmentOpen(Segment *segment, const char *path, int sequence) {
+    memset(segment, 0, sizeof(Segment));
+    segment->fd = -1;
+    segment->sequence = sequence;
+    strncpy(segment->path, path, sizeof(segment->path) - 1);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open segment %s.\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(FILE_HEADER_SIZE + sizeof(SegmentFooter))) {
+        fprintf(stderr, "Error: %s is not a sealed segment.\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    segment->fd = fd;
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Unable to map segment %s.\n", path);
+        segmentClose(segment);
+        return -1;
+    }
+    segment->map = (unsigned char*)map;
+    segment->length = (size_t)st.st_size;
+
+    SegmentFooter *footer = &segment->footer;
+    memcpy(footer, segment->map + segment->length - sizeof(SegmentFooter), sizeof(SegmentFooter));
+    int64_t footerOffset = (int64_t)(segment->length - sizeof(SegmentFooter));
+    if (checkFileHeader(segment->map, segment->length) != 0
+        || strncmp(footer->magic, SEGMENT_MAGIC, sizeof(footer->magic)) != 0
+        || footer->recordsEnd > footer->sparseOffset
+        || footer->sparseOffset % 8 != 0
+        || footer->sparseOffset + (int64_t)footer->sparseCount * (int64_t)sizeof(IndexRecord) != footer->bloomOffset
+        || footer->bloomOffset + (int64_t)(footer->bloomBitCount / 8) != footerOffset) {
+        fprintf(stderr, "Error: %s is not a sealed segment.\n", path);
+        segmentClose(segment);
+        return -1;
+    }
+    segment->sparse = (const IndexRecord*)(segment->map + footer->sparseOffset);
+
+    // The filter bits are copied so the filter can be used like any other
+    segment->bloom.bits = (uint64_t*)malloc(footer->bloomBitCount / 8 + 8);
+    if (segment->bloom.bits == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for segment %s.\n", path);
+        segmentClose(segment);
+        return -1;
+    }
+    memcpy(segment->bloom.bits, segment->map + footer->bloomOffset, footer->bloomBitCount / 8);
+    segment->bloom.bitCount = footer->bloomBitCount;
+    segment->bloom.hashCount = footer->bloomHashCount;
+    segment->bloom.capacity = (uint64_t)footer->recordCount;
+    segment->bloom.count = (uint64_t)footer->recordCount;
+    return 0;
+}
+
+/**
+  * Check the identifier range and Bloom filter of a segment, without touching its records.
+  *
+  * Parameters:
+  * - segment: Pointer to Segment structure.
+  * - identifier: integer, identifier of the message.
+  *
+  * return value:
+  * - bool: false if the message is certainly not in the segment.
+  */
+bool segmentMayContain(const Segment *segment, int identifier) {
+    if (segment->footer.recordCount == 0 || identifier < segment->footer.minId || identifier > segment->footer.maxId) {
+        return false;
+    }
+    return bloomMayContain(&segment->bloom, identifier);
+}
+
+/**
+  * Scan records sorted by identifier for a message.
+  *
+  * Parameters:
+  * - start: first record.
+  * - end: end of the records.
+  * - identifier: integer, identifier of the message.
+  * - msg: Pointer to the Message structure that receives the message, NULL to only check that it is there.
+  *
+  * return value:
+  * - int: 1 if found, 0 if not there, -1 if a record is corrupt.
+  */
+static int scanRecords(const unsigned char *start, const unsigned char *end, int identifier, Message *msg) {
+    while (start < end) {
+        if (end - start < RECORD_HEADER_SIZE) {
+            return -1;
+        }
+        uint32_t length = recordLength(start);
+        if (length < RECORD_HEADER_SIZE || length > (size_t)(end - start)) {
+            return -1;
+        }
+        int recordId = recordIdentifier(start);
+        if (recordId == identifier) {
+            if (msg == NULL) {
+                return 1;
+            }
+            return decodeRecord(start, length, msg) == (int)length ? 1 : -1;
+        }
+        if (recordId > identifier) {
+            return 0;
+        }
+        start += length;
+    }
+    return 0;
+}
+
+/**
+  * Find the byte range of a segment that holds a message if it is in the segment: the records
+  * between two sparse index entries, or one block of a compressed segment.
+  *
+  * Parameters:
+  * - segment: Pointer to Segment structure.
+  * - identifier: integer, identifier of the message.
+  * - offset: Pointer that receives the offset of the range in the segment file.
+  * - length: Pointer that receives the length of the range.
+  *
+  * return value:
+  * - int: 1 if the range was found, 0 if the message is certainly not in the segment, -1 if the segment is corrupt.
+  */
+int segmentSpan(const Segment *segment, int identifier, int64_t *offset, int32_t *length) {
+    if (!segmentMayContain(segment, identifier)) {
+        return 0;
+    }
+
+    // Last sparse entry whose identifier is <= identifier
+    int low = 0, high = segment->footer.sparseCount - 1, found = -1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (segment->sparse[mid].identifier <= identifier) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (found < 0) {
+        return 0;
+    }
+
+    int64_t start = segment->sparse[found].offset;
+    int64_t end;
+    if (segment->footer.flags & SEGMENT_COMPRESSED) {
+        end = start + segment->sparse[found].length;
+    } else {
+        end = found + 1 < segment->footer.sparseCount ? segment->sparse[found + 1].offset : segment->footer.recordsEnd;
+    }
+    if (start < FILE_HEADER_SIZE || end < start || end > segment->footer.recordsEnd) {
+        return -1;
+    }
+    *offset = start;
+    *length = (int32_t)(end - start);
+    return 1;
+}
+
+/**
+  * Look for a message in a range returned by segmentSpan (or in a single record), wherever its bytes are.
+  *
+  * Parameters:
+  * - span: bytes of the range.
+  * - length: length of the range.
+  * - compressed: true if the range is a block of a compressed segment.
+  * - identifier: integer, identifier of the message.
+  * - msg: Pointer to the Message structure that receives the message, NULL to only check that it is there.
+  *
+  * return value:
+  * - int: 1 if found, 0 if not in the range, -1 if the range is corrupt.
+  */
+int segmentScanSpan(const unsigned char *span, size_t length, bool compressed, int identifier, Message *msg) {
+    if (!compressed) {
+        return scanRecords(span, span + length, identifier, msg);
+    }
+
+    uint32_t dataLength, rawLength;
+    if (length < BLOCK_HEADER_SIZE) {
+        return -1;
+    }
+    memcpy(&dataLength, span, sizeof(dataLength));
+    memcpy(&rawLength, span + 4, sizeof(rawLength));
+    if (dataLength != length - BLOCK_HEADER_SIZE || rawLength > BLOCK_MAX_SIZE) {
+        return -1;
+    }
+    if (dataLength == rawLength) {
+        return scanRecords(span + BLOCK_HEADER_SIZE, span + BLOCK_HEADER_SIZE + rawLength, identifier, msg);
+    }
+    unsigned char block[BLOCK_MAX_SIZE];
+    if (lzDecompress(span + BLOCK_HEADER_SIZE, (int)dataLength, block, sizeof(block)) != (int)rawLength) {
+        return -1;
+    }
+    return scanRecords(block, block + rawLength, identifier, msg);
+}
+
+/**
+  * Find a message in a segment: binary search of the sparse index, then a scan of at most
+  * SPARSE_INTERVAL records in the mapping. In a compressed segment the block that can hold
+  * the message is decompressed and scanned.
+  *
+  * Parameters:
+  * - segment: Pointer to Segment structure.
+  * - identifier: integer, identifier of the message.
+  * - msg: Pointer to the Message structure that receives the message, NULL to only check that it is there.
+  *
+  * return value:
+  * - int: 1 if found, 0 if not in the segment, -1 if the segment is corrupt.
+  */
+int segmentFind(const Segment *segment, int identifier, Message *msg) {
+    int64_t offset;
+    int32_t length;
+    int result = segmentSpan(segment, identifier, &offset, &length);
+    if (result != 1) {
+        return result;
+    }
+    return segmentScanSpan(segment->map + offset, (size_t)length, segment->footer.flags & SEGMENT_COMPRESSED,
+                           identifier, msg);
+}
+
+/**
+  * Unmap and close a segment and release its Bloom filter.
+  *
+  * Parameters:
+  * - segment: Pointer to Segment structure.
+  */
+void segmentClose(Segment *segment) {
+    if (segment->map != NULL) {
+        munmap(segment->map, segment->length);
+        segment->map = NULL;
+    }
+    if (segment->fd >= 0) {
+        close(segment->fd);
+        segment->fd = -1;
+    }
+    bloomFree(&segment->bloom);
+    segment->sparse = NULL;
+}
+
+/**
+  * Start writing a sealed segment. It is written to "<path>.tmp" and renamed by segmentWriterFinish.
+  *
+  * Parameters:
+  * - writer: Pointer to SegmentWriter structure to initialize.
+  * - path: string, final path of the segment.
+  * - expectedRecords: integer, number of records the Bloom filter is sized for.
+  * - falsePositiveRate: target false-positive rate of the Bloom filter.
+  * - compressed: true to pack the records into compressed blocks.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure.
+  */
+int segmentWriterOpen(SegmentWriter *writer, const char *path, int expectedRecords, double falsePositiveRate, bool compressed) {
+    memset(writer, 0, sizeof(SegmentWriter));
+    strncpy(writer->path, path, sizeof(writer->path) - 1);
+    snprintf(writer->tmpPath, sizeof(writer->tmpPath), "%s.tmp", path);
+    if (bloomInit(&writer->bloom, (uint64_t)expectedRecords, falsePositiveRate) != 0) {
+        return -1;
+    }
+    if (compressed) {
+        writer->block = (unsigned char*)malloc(BLOCK_MAX_SIZE + BLOCK_HEADER_SIZE + LZ_BOUND(BLOCK_MAX_SIZE));
+        if (writer->block == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for SegmentWriter.\n");
+            bloomFree(&writer->bloom);
+            return -1;
+        }
+        writer->footer.flags = SEGMENT_COMPRESSED;
+    }
+    writer->file = fopen(writer->tmpPath, "wb");
+    if (writer->file == NULL || writeFileHeader(writer->file, generateFileId()) != 0) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", writer->tmpPath);
+        segmentWriterAbort(writer);
+        return -1;
+    }
+    writer->offset = FILE_HEADER_SIZE;
+    strncpy(writer->footer.magic, SEGMENT_MAGIC, sizeof(writer->footer.magic));
+    writer->footer.minId = INT_MAX;
+    writer->footer.maxId = INT_MIN;
+    writer->footer.minTime = INT64_MAX;
+    writer->footer.maxTime = INT64_MIN;
+    return 0;
+}
+
+/**
+  * Add an entry to the sparse index of the segment being written.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+static int segmentWriterAddSparse(SegmentWriter *writer, int identifier, int32_t length, int64_t offset) {
+    if (writer->footer.sparseCount == writer->sparseCapacity) {
+        int capacity = writer->sparseCapacity == 0 ? 64 : writer->sparseCapacity * 2;
+        IndexRecord *sparse = (IndexRecord*)realloc(writer->sparse, capacity * sizeof(IndexRecord));
+        if (sparse == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for SegmentWriter.\n");
+            return -1;
+        }
+        writer->sparse = sparse;
+        writer->sparseCapacity = capacity;
+    }
+    writer->sparse[writer->footer.sparseCount++] = (IndexRecord){ .identifier = identifier, .length = length, .offset = offset };
+    return 0;
+}
+
+/**
+  * Compress the block being filled, write it and index it.
+  *
+  * Parameters:
+  * - writer: Pointer to SegmentWriter structure of a compressed segment.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure.
+  */
+static int segmentWriterFlushBlock(SegmentWriter *writer) {
+    if (writer->blockUsed == 0) {
+        return 0;
+    }
+    uint32_t rawLength = (uint32_t)writer->blockUsed;
+    unsigned char *stored = writer->block + BLOCK_MAX_SIZE;
+    int compressedLength = lzCompress(writer->block, (int)rawLength, stored + BLOCK_HEADER_SIZE, LZ_BOUND(BLOCK_MAX_SIZE));
+    uint32_t dataLength = rawLength;
+    if (compressedLength >= 0 && (uint32_t)compressedLength < rawLength) {
+        dataLength = (uint32_t)compressedLength;
+    } else {
+        memcpy(stored + BLOCK_HEADER_SIZE, writer->block, rawLength);
+    }
+    memcpy(stored, &dataLength, sizeof(dataLength));
+    memcpy(stored + 4, &rawLength, sizeof(rawLength));
+
+    int32_t storedLength = (int32_t)(BLOCK_HEADER_SIZE + dataLength);
+    if (segmentWriterAddSparse(writer, writer->blockFirstId, storedLength, writer->offset) != 0) {
+        return -1;
+    }
+    if (fwrite(stored, storedLength, 1, writer->file) != 1) {
+        fprintf(stderr, "Error: Unable to write segment %s.\n", writer->path);
+        return -1;
+    }
+    writer->offset += storedLength;
+    writer->blockUsed = 0;
+    return 0;
+}
+
+/**
+  * Add an encoded record to the segment. Records must come in strictly increasing identifier order.
+  *
+  * Parameters:
+  * - writer: Pointer to SegmentWriter structure.
+  * - record: encoded record.
+  * - length: length of the record in bytes.
+  *
+  * return value:
+  * - int: 0 on success, -1 on write failure or if the identifier is out of order.
+  */
+int segmentWriterAdd(SegmentWriter *writer, const unsigned char *record, uint32_t length) {
+    int identifier = recordIdentifier(record);
+    if (writer->footer.recordCount > 0 && identifier <= writer->footer.maxId) {
+        fprintf(stderr, "Error: message ID：%d is out of order in segment %s.\n", identifier, writer->path);
+        return -1;
+    }
+
+    if (writer->block != NULL) {
+        if (writer->blockUsed == 0) {
+            writer->blockFirstId = identifier;
+        }
+        memcpy(writer->block + writer->blockUsed, record, length);
+        writer->blockUsed += length;
+        if (writer->blockUsed >= SEGMENT_BLOCK_SIZE && segmentWriterFlushBlock(writer) != 0) {
+            return -1;
+        }
+    } else {
+        if (writer->footer.recordCount % SPARSE_INTERVAL == 0
+            && segmentWriterAddSparse(writer, identifier, (int32_t)length, writer->offset) != 0) {
+            return -1;
+        }
+        if (fwrite(record, length, 1, writer->file) != 1) {
+            fprintf(stderr, "Error: Unable to write segment %s.\n", writer->path);
+            return -1;
+        }
+        writer->offset += length;
+    }
+
+    int64_t timeSent = recordTimeSent(record);
+    SegmentFooter *footer = &writer->footer;
+    if (identifier < footer->minId) {
+        footer->minId = identifier;
+    }
+    footer->maxId = identifier;
+    if (timeSent < footer->minTime) {
+        footer->minTime = timeSent;
+    }
+    if (timeSent > footer->maxTime) {
+        footer->maxTime = timeSent;
+    }
+    footer->recordCount++;
+    bloomAdd(&writer->bloom, identifier);
+    return 0;
+}
+
+/**
+  * Write the sparse index, Bloom filter and footer, sync the file and rename it into place.
+  *
+  * Parameters:
+  * - writer: Pointer to SegmentWriter structure.
+  *
+  * return value:
+  * - int: 0 on success, -1 on failure (the temporary file is removed).
+  */
+int segmentWriterFinish(SegmentWriter *writer) {
+    SegmentFooter *footer = &writer->footer;
+    static const unsigned char zeros[8] = {0};
+    if (writer->block != NULL && segmentWriterFlushBlock(writer) != 0) {
+        segmentWriterAbort(writer);
+        return -1;
+    }
+    footer->recordsEnd = writer->offset;
+    footer->sparseOffset = (writer->offset + 7) & ~(int64_t)7;
+    footer->bloomOffset = footer->sparseOffset + (int64_t)footer->sparseCount * (int64_t)sizeof(IndexRecord);
+    footer->bloomBitCount = writer->bloom.bitCount;
+    footer->bloomHashCount = writer->bloom.hashCount;
+
+    bool ok = fwrite(zeros, (size_t)(footer->sparseOffset - writer->offset), 1, writer->file) == 1
+              || footer->sparseOffset == writer->offset;
+    ok = ok && (footer->sparseCount == 0
+                || fwrite(writer->sparse, sizeof(IndexRecord), footer->sparseCount, writer->file) == (size_t)footer->sparseCount);
+    ok = ok && fwrite(writer->bloom.bits, writer->bloom.bitCount / 8, 1, writer->file) == 1;
+    ok = ok && fwrite(footer, sizeof(SegmentFooter), 1, writer->file) == 1;
+    ok = ok && fflush(writer->file) == 0 && fsync(fileno(writer->file)) == 0;
+    ok = fclose(writer->file) == 0 && ok;
+    writer->file = NULL;
+    ok = ok && rename(writer->tmpPath, writer->path) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error: Unable to write segment %s.\n", writer->path);
+        segmentWriterAbort(writer);
+        return -1;
+    }
+    free(writer->sparse);
+    writer->sparse = NULL;
+    free(writer->block);
+    writer->block = NULL;
+    bloomFree(&writer->bloom);
+    return 0;
+}
+
+/**
+  * Give up writing a segment and remove its temporary file.
+  *
+  * Parameters:
+  * - writer: Pointer to SegmentWriter structure.
+  */
+void segmentWriterAbort(SegmentWriter *writer) {
+    if (writer->file != NULL) {
+        fclose(writer->file);
+        writer->file = NULL;
+    }
+    unlink(writer->tmpPath);
+    free(writer->sparse);
+    writer->sparse = NULL;
+    free(writer->block);
+    writer->block = NULL;
+    bloomFree(&writer->bloom);
+}
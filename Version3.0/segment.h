@@ -0,0 +1,91 @@
+/*
+* segment.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_SEGMENT_H
+#define P1_SEGMENT_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "message.h"
+#include "disk_index.h"
+#include "bloom.h"
+
+/*
+ * A sealed segment is an immutable message file:
+ *   file header (same as the active message file)
+ *   records sorted by identifier, one per identifier
+ *   padding to 8 bytes
+ *   sparse index: an IndexRecord for every SPARSE_INTERVAL-th record
+ *   Bloom filter bits of all identifiers
+ *   SegmentFooter (fixed size, last bytes of the file)
+ *
+ * In a compressed segment (SEGMENT_COMPRESSED) the records are packed into blocks of about
+ * SEGMENT_BLOCK_SIZE bytes, each stored as
+ *   uint32 stored length, uint32 raw length, block compressed with lzCompress (or raw if that is not smaller)
+ * and the sparse index has one IndexRecord per block: its first identifier, offset and stored size.
+ */
+#define SEGMENT_MAGIC "P1SEG"
+#define SPARSE_INTERVAL 16
+#define SEGMENT_COMPRESSED 1
+#define SEGMENT_BLOCK_SIZE 4096
+#define BLOCK_HEADER_SIZE 8
+
+typedef struct SegmentFooter {
+    char magic[8];
+    int32_t recordCount;
+    int32_t sparseCount;
+    int32_t minId;
+    int32_t maxId;
+    int64_t minTime;
+    int64_t maxTime;
+    int64_t recordsEnd;     //offset of the first byte after the records
+    int64_t sparseOffset;
+    int64_t bloomOffset;
+    uint64_t bloomBitCount;
+    int32_t bloomHashCount;
+    int32_t flags;          //SEGMENT_COMPRESSED
+} SegmentFooter;
+
+typedef struct Segment {
+    int sequence;             //segments are numbered in the order they were sealed
+    char path[272];
+    int fd;                   //kept open for asynchronous reads
+    unsigned char *map;       //read-only mapping of the whole file
+    size_t length;
+    SegmentFooter footer;
+    const IndexRecord *sparse; //points into the mapping
+    BloomFilter bloom;
+} Segment;
+
+typedef struct SegmentWriter {
+    char path[272];
+    char tmpPath[288];
+    FILE *file;
+    int64_t offset;
+    IndexRecord *sparse;
+    int sparseCapacity;
+    BloomFilter bloom;
+    SegmentFooter footer;
+    //Compressed segments only: the block being filled, followed by room for its compressed copy
+    unsigned char *block;
+    size_t blockUsed;
+    int blockFirstId;
+} SegmentWriter;
+
+int segmentOpen(Segment *segment, const char *path, int sequence);
+bool segmentMayContain(const Segment *segment, int identifier);
+int segmentSpan(const Segment *segment, int identifier, int64_t *offset, int32_t *length);
+int segmentScanSpan(const unsigned char *span, size_t length, bool compressed, int identifier, Message *msg);
+int segmentFind(const Segment *segment, int identifier, Message *msg);
+void segmentClose(Segment *segment);
+
+int segmentWriterOpen(SegmentWriter *writer, const char *path, int expectedRecords, double falsePositiveRate, bool compressed);
+int segmentWriterAdd(SegmentWriter *writer, const unsigned char *record, uint32_t length);
+int segmentWriterFinish(SegmentWriter *writer);
+void segmentWriterAbort(SegmentWriter *writer);
+#endif //P1_SEGMENT_H
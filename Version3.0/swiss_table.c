@@ -0,0 +1,265 @@
+/*
+* swiss_table.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "swiss_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+  * Hash of a key: the low 7 bits are the fingerprint stored in the control byte, the rest choose the first group.
+  */
+static uint32_t swissHash(int key) {
+    uint64_t hash = (uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(hash >> 32) ^ (uint32_t)hash;
+}
+
+#ifdef __SSE2__
+/**
+  * Bit mask of the slots of a group whose control byte equals value (bit i for slot i).
+  */
+static inline uint32_t groupMatch(const signed char *group, signed char value) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+}
+
+/**
+  * Bit mask of the slots of a group that are empty or deleted (control bytes with the high bit set).
+  */
+static inline uint32_t groupMatchFree(const signed char *group) {
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+#else
+static inline uint32_t groupMatch(const signed char *group, signed char value) {
+    uint32_t mask = 0;
+    for (int i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] == value) << i;
+    }
+    return mask;
+}
+
+static inline uint32_t groupMatchFree(const signed char *group) {
+    uint32_t mask = 0;
+    for (int i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(group[i] < 0) << i;
+    }
+    return mask;
+}
+#endif
+
+/**
+  * Allocate the arrays of a table with all slots empty.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+static int swissAlloc(SwissTable *table, int capacity) {
+    table->ctrl = (signed char*)malloc(capacity);
+    table->keys = (int*)malloc(capacity * sizeof(int));
+    table->values = (CacheHashEntry**)malloc(capacity * sizeof(CacheHashEntry*));
+    if (table->ctrl == NULL || table->keys == NULL || table->values == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for SwissTable.\n");
+        free(table->ctrl);
+        free(table->keys);
+        free(table->values);
+        table->ctrl = NULL;
+        table->keys = NULL;
+        table->values = NULL;
+        return -1;
+    }
+    memset(table->ctrl, SWISS_EMPTY, capacity);
+    table->capacity = capacity;
+    table->used = 0;
+    table->deleted = 0;
+    return 0;
+}
+
+/**
+  * Initialize an empty Swiss table.
+  *
+  * Parameters:
+  * - table: Pointer to SwissTable structure to initialize.
+  * - expectedEntries: integer, sizing hint; the table grows as needed.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed.
+  */
+int swissInit(SwissTable *table, int expectedEntries) {
+    int capacity = SWISS_MIN_CAPACITY;
+    while ((long long)capacity * SWISS_MAX_LOAD_NUM / SWISS_MAX_LOAD_DEN < expectedEntries) {
+        capacity *= 2;
+    }
+    return swissAlloc(table, capacity);
+}
+
+/**
+  * Slot of the first empty or deleted slot on the probe sequence of a hash.
+  * The groups are visited in triangular order, which reaches every group of a power-of-two table.
+  */
+static int findFreeSlot(const SwissTable *table, uint32_t hash) {
+    int groupMask = table->capacity / SWISS_GROUP_WIDTH - 1;
+    int group = (int)(hash >> 7) & groupMask;
+    for (int step = 1;; step++) {
+        uint32_t free = groupMatchFree(table->ctrl + group * SWISS_GROUP_WIDTH);
+        if (free != 0) {
+            return group * SWISS_GROUP_WIDTH + __builtin_ctz(free);
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+  * Slot holding a key, or -1 if the key is not in the table.
+  */
+static int findSlot(const SwissTable *table, int key) {
+    uint32_t hash = swissHash(key);
+    signed char fingerprint = (signed char)(hash & 0x7f);
+    int groupMask = table->capacity / SWISS_GROUP_WIDTH - 1;
+    int group = (int)(hash >> 7) & groupMask;
+    for (int step = 1; step <= groupMask + 1; step++) {
+        const signed char *ctrl = table->ctrl + group * SWISS_GROUP_WIDTH;
+        for (uint32_t match = groupMatch(ctrl, fingerprint); match != 0; match &= match - 1) {
+            int slot = group * SWISS_GROUP_WIDTH + __builtin_ctz(match);
+            if (table->keys[slot] == key) {
+                return slot;
+            }
+        }
+        // A probe sequence never continues past a group that still has an empty slot
+        if (groupMatch(ctrl, SWISS_EMPTY) != 0) {
+            return -1;
+        }
+        group = (group + step) & groupMask;
+    }
+    return -1;
+}
+
+/**
+  * Move all entries to a table of a new capacity, which also drops the deleted markers.
+  *
+  * return value:
+  * - int: 0 on success, -1 if memory allocation failed (the table is left as it was).
+  */
+static int swissResize(SwissTable *table, int capacity) {
+    SwissTable old = *table;
+    if (swissAlloc(table, capacity) != 0) {
+        *table = old;
+        return -1;
+    }
+    for (int i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] >= 0) {
+            int slot = findFreeSlot(table, swissHash(old.keys[i]));
+            table->ctrl[slot] = old.ctrl[i];
+            table->keys[slot] = old.keys[i];
+            table->values[slot] = old.values[i];
+            table->used++;
+        }
+    }
+    free(old.ctrl);
+    free(old.keys);
+    free(old.values);
+    return 0;
+}
+
+/**
+  * Find the entry of a key.
+  *
+  * Parameters:
+  * - table: Pointer to SwissTable structure.
+  * - key: integer, message identifier.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to the entry, or NULL if the key is not in the table.
+  */
+CacheHashEntry* swissFind(const SwissTable *table, int key) {
+    int slot = findSlot(table, key);
+    return slot >= 0 ? table->values[slot] : NULL;
+}
+
+/**
+  * Insert an entry whose key is not in the table yet. The table is rebuilt once 7/8 of the slots are taken:
+  * twice as large if they are mostly full, the same size if they are mostly deleted.
+  *
+  * Parameters:
+  * - table: Pointer to SwissTable structure.
+  * - entry: Pointer to the CacheHashEntry to insert.
+  *
+  * return value:
+  * - int: 0 on success, -1 if the table had to grow and memory allocation failed.
+  */
+int swissInsert(SwissTable *table, CacheHashEntry *entry) {
+    if ((long long)(table->used + table->deleted + 1) * SWISS_MAX_LOAD_DEN > (long long)table->capacity * SWISS_MAX_LOAD_NUM) {
+        int capacity = table->used * 2 >= table->capacity * SWISS_MAX_LOAD_NUM / SWISS_MAX_LOAD_DEN
+                       ? table->capacity * 2 : table->capacity;
+        if (swissResize(table, capacity) != 0) {
+            return -1;
+        }
+    }
+    uint32_t hash = swissHash(entry->key);
+    int slot = findFreeSlot(table, hash);
+    if (table->ctrl[slot] == SWISS_DELETED) {
+        table->deleted--;
+    }
+    table->ctrl[slot] = (signed char)(hash & 0x7f);
+    table->keys[slot] = entry->key;
+    table->values[slot] = entry;
+    table->used++;
+    return 0;
+}
+
+/**
+  * Remove the entry of a key. The table shrinks once fewer than 1/8 of its slots are full.
+  *
+  * Parameters:
+  * - table: Pointer to SwissTable structure.
+  * - key: integer, message identifier.
+  *
+  * return value:
+  * - CacheHashEntry*: Pointer to the removed entry (owned by the caller), or NULL if the key is not in the table.
+  */
+CacheHashEntry* swissRemove(SwissTable *table, int key) {
+    int slot = findSlot(table, key);
+    if (slot < 0) {
+        return NULL;
+    }
+    CacheHashEntry *entry = table->values[slot];
+    // Probes stop at a group with an empty slot, so the slot can be emptied instead of marked deleted
+    const signed char *group = table->ctrl + (slot & ~(SWISS_GROUP_WIDTH - 1));
+    if (groupMatch(group, SWISS_EMPTY) != 0) {
+        table->ctrl[slot] = SWISS_EMPTY;
+    } else {
+        table->ctrl[slot] = SWISS_DELETED;
+        table->deleted++;
+    }
+    table->used--;
+    if (table->capacity > SWISS_MIN_CAPACITY && table->used < table->capacity / 8) {
+        swissResize(table, table->capacity / 2);
+    }
+    return entry;
+}
+
+/**
+  * Free the arrays of the table. The entries are not freed, they belong to the caller (the entry slab of a cache).
+  *
+  * Parameters:
+  * - table: Pointer to SwissTable structure.
+  */
+void swissDestroy(SwissTable *table) {
+    free(table->ctrl);
+    free(table->keys);
+    free(table->values);
+    table->ctrl = NULL;
+    table->keys = NULL;
+    table->values = NULL;
+    table->capacity = 0;
+    table->used = 0;
+    table->deleted = 0;
+}
@@ -0,0 +1,27 @@
+/*
+* swiss_table.h / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#ifndef P1_SWISS_TABLE_H
+#define P1_SWISS_TABLE_H
+#include "message.h"
+
+//Define the layout of the Swiss table (see SwissTable in message.h)
+#define SWISS_GROUP_WIDTH 16
+#define SWISS_EMPTY ((signed char)-128)
+#define SWISS_DELETED ((signed char)-2)
+#define SWISS_MIN_CAPACITY 16
+//The table grows once 7/8 of its slots are full or deleted
+#define SWISS_MAX_LOAD_NUM 7
+#define SWISS_MAX_LOAD_DEN 8
+
+int swissInit(SwissTable *table, int expectedEntries);
+CacheHashEntry* swissFind(const SwissTable *table, int key);
+int swissInsert(SwissTable *table, CacheHashEntry *entry);
+CacheHashEntry* swissRemove(SwissTable *table, int key);
+void swissDestroy(SwissTable *table);
+#endif //P1_SWISS_TABLE_H
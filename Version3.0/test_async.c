@@ -0,0 +1,93 @@
+/*
+* test_async.c / Memory Hierarchy Simulation
+*
+* Chenyu Song / CS5600 / Northeastern University
+* Fall 2023 / Nov 13, 2023
+*
+*/
+
+#include "message.h"
+#include "disk_store.h"
+#include "async_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//Define the test: messages on disk, capacity of the cache, asynchronous retrieves in flight at teardown
+#define TEST_MESSAGES 200
+#define TEST_CAPACITY 16
+#define TEST_IN_FLIGHT ASYNC_QUEUE_DEPTH
+
+static int callbacks = 0;
+static int failures = 0;
+
+/**
+  * Check the result of an asynchronous retrieve and free it unless it points into the cache.
+  */
+static void checkResult(MessageWithStatus *result, void *context) {
+    int identifier = *(int*)context;
+    callbacks++;
+    if (result == NULL || result->hitStatus == 3 || result->message.identifier != identifier) {
+        fprintf(stderr, "Error: Asynchronous retrieve of message ID：%d returned a wrong result.\n", identifier);
+        failures++;
+    }
+    if (result != NULL && result->hitStatus != 1) {
+        free(result);
+    }
+}
+
+/**
+  * Destroy a cache while asynchronous retrieves into it are in flight, then close the store, the order main.c uses.
+  * Every callback has to run before destroyCache returns, while the cache still exists.
+  */
+int main() {
+    char directory[] = "/tmp/p1_test_XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) != 0) {
+        fprintf(stderr, "Error: Unable to create a scratch directory.\n");
+        return 1;
+    }
+
+    CacheConfig config = { .capacity = TEST_CAPACITY, .repStrategy = REP_LRU };
+    Cache *cache = createCache(&config);
+    if (cache == NULL) {
+        return 1;
+    }
+    for (int i = 0; i < TEST_MESSAGES; i++) {
+        Message *msg = create_msg(i, "s1", "r1", "test content", 0, Context_limit);
+        if (msg != NULL) {
+            store_msg(msg, cache);
+            free(msg);
+        }
+    }
+    destroyCache(cache);
+    //Reopen the store, so the reads go to the file and not to the write buffer
+    closeMessageStore();
+
+    cache = createCache(&config);
+    if (cache == NULL) {
+        return 1;
+    }
+    int identifiers[TEST_IN_FLIGHT];
+    int inFlight = 0;
+    for (int i = 0; i < TEST_IN_FLIGHT; i++) {
+        identifiers[i] = TEST_MESSAGES - 1 - i;
+        inFlight += retrieve_msg_async(identifiers[i], cache, checkResult, &identifiers[i]);
+    }
+    destroyCache(cache);
+    int callbacksBeforeClose = callbacks;
+    closeMessageStore();
+
+    printf("%d retrieves in flight, %d callbacks before the store was closed\n", inFlight, callbacksBeforeClose);
+    if (callbacksBeforeClose != TEST_IN_FLIGHT || callbacks != TEST_IN_FLIGHT || failures != 0) {
+        fprintf(stderr, "Error: destroyCache left asynchronous retrieves behind.\n");
+        return 1;
+    }
+
+    unlink(MESSAGE_FILE);
+    unlink(INDEX_FILE);
+    if (chdir("/") == 0) {
+        rmdir(directory);
+    }
+    return 0;
+}